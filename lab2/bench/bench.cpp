@@ -0,0 +1,7 @@
+// the triangulation benchmark on its own, without a window: bench [max points] [engine]
+#include "../lab2/benchmark.h"
+#include <cstdlib>
+
+int main(int argc, char *argv[]) {
+	return runBenchmark(argc > 1 ? atoi(argv[1]) : 1000000, argc > 2 ? argv[2] : "all");
+}
@@ -0,0 +1,278 @@
+#include "benchmark.h"
+#include "triangulate.h"
+#include "parallel.h"
+#include "mesh.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <map>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+
+// an engine that took longer than this on a distribution isn't run on more points of it
+static const double TIME_LIMIT = 60.0;
+
+/*
+Every allocation of the program goes through the operators below, which
+count the bytes in use and the most there have been since the count was
+last reset; each block carries its size in a header in front of it, as
+big as malloc's alignment so the block after it is aligned the same.
+That gives every run its own peak, which the peak of the process can't:
+it only ever grows, so after the largest run it says the same for all
+*/
+static std::atomic<size_t> heapInUse(0), heapPeak(0);
+static const size_t HEAP_HEADER = 16;
+
+static void *countedAlloc(size_t size) {
+	auto block = static_cast<char*>(std::malloc(size + HEAP_HEADER));
+	if (!block)
+		return nullptr;
+
+	*reinterpret_cast<size_t*>(block) = size;
+	auto inUse = heapInUse += size;
+	auto peak = heapPeak.load();
+	while (inUse > peak && !heapPeak.compare_exchange_weak(peak, inUse))
+		;
+
+	return block + HEAP_HEADER;
+}
+
+static void countedFree(void *pointer) {
+	if (!pointer)
+		return;
+
+	auto block = static_cast<char*>(pointer) - HEAP_HEADER;
+	heapInUse -= *reinterpret_cast<size_t*>(block);
+	std::free(block);
+}
+
+void *operator new(size_t size) {
+	auto pointer = countedAlloc(size);
+	if (!pointer)
+		throw std::bad_alloc();
+	return pointer;
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept { return countedAlloc(size); }
+void *operator new[](size_t size, const std::nothrow_t &) noexcept { return countedAlloc(size); }
+void operator delete(void *pointer) noexcept { countedFree(pointer); }
+void operator delete[](void *pointer) noexcept { countedFree(pointer); }
+void operator delete(void *pointer, size_t) noexcept { countedFree(pointer); }
+void operator delete[](void *pointer, size_t) noexcept { countedFree(pointer); }
+void operator delete(void *pointer, const std::nothrow_t &) noexcept { countedFree(pointer); }
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept { countedFree(pointer); }
+
+// start a run's peak at what is in use now, returned to subtract at the end
+static size_t resetHeapPeak() {
+	auto inUse = heapInUse.load();
+	heapPeak = inUse;
+	return inUse;
+}
+
+/*
+The point sets:
+uniform   - the unit square
+clusters  - 16 Gaussian blobs much smaller than the space between them
+grid      - a square lattice, so every cell is four cocircular points
+circle    - all on one circle around a centre point
+collinear - a line with the points a few ulps off it
+range     - radii spread over twelve orders of magnitude
+*/
+static const char *DISTRIBUTIONS[] = { "uniform", "clusters", "grid", "circle", "collinear", "range" };
+
+static void makePoints(const std::string &distribution, int pointNumber, std::vector<XYZ> &points) {
+	std::mt19937_64 random(20160301u + pointNumber);
+	std::uniform_real_distribution<double> unit(0.0, 1.0);
+	const double PI = 3.14159265358979323846;
+
+	points.resize(pointNumber);
+
+	if (distribution == "uniform")
+		for (auto &point : points)
+			point = XYZ(unit(random), unit(random), 0.0);
+	else if (distribution == "clusters") {
+		std::normal_distribution<double> spread(0.0, 0.002);
+		XYZ centres[16];
+
+		for (auto &centre : centres)
+			centre = XYZ(unit(random), unit(random), 0.0);
+		for (auto &point : points) {
+			auto &centre = centres[random() % 16];
+			point = XYZ(centre.x + spread(random), centre.y + spread(random), 0.0);
+		}
+	}
+	else if (distribution == "grid") {
+		auto side = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(pointNumber))));
+
+		for (int i = 0; i < pointNumber; i++)
+			points[i] = XYZ(i % side, i / side, 0.0);
+	}
+	else if (distribution == "circle") {
+		points[0] = XYZ(0.0, 0.0, 0.0);
+		for (int i = 1; i < pointNumber; i++) {
+			auto angle = 2.0 * PI * unit(random);
+			points[i] = XYZ(std::cos(angle), std::sin(angle), 0.0);
+		}
+	}
+	else if (distribution == "collinear")
+		for (auto &point : points) {
+			auto t = unit(random);
+			point = XYZ(t, 0.5 * t + 1e-15 * (unit(random) - 0.5), 0.0);
+		}
+	else if (distribution == "range")
+		for (auto &point : points) {
+			auto radius = std::pow(10.0, -4.0 + 12.0 * unit(random));
+			auto angle = 2.0 * PI * unit(random);
+			point = XYZ(radius * std::cos(angle), radius * std::sin(angle), 0.0);
+		}
+}
+
+// triangulate with one engine, result in the form Triangulate gives it
+static int triangulate(const std::string &engine, const std::vector<XYZ> &points, std::vector<Triangle> &triangles) {
+	auto pointNumber = static_cast<int>(points.size());
+
+	if (engine == "incremental") {
+		Triangulate incremental;
+		return incremental.triangulate(points, triangles);
+	}
+
+	if (engine == "parallel") {
+		triangles.resize(2 * pointNumber + 1);
+		triangles.resize(ParallelTriangulate::triangulate(pointNumber, points.data(), triangles.data()));
+		return static_cast<int>(triangles.size());
+	}
+
+	// the mesh numbers its vertices itself and leaves out coincident points
+	DelaunayMesh mesh;
+	std::vector<int> vertexOf;
+	mesh.insert(points, vertexOf);
+	mesh.triangles(triangles);
+
+	std::vector<int> pointOf(mesh.vertexCapacity(), -1);
+	for (int i = pointNumber - 1; i >= 0; i--)
+		pointOf[vertexOf[i]] = i;
+
+	for (auto &triangle : triangles) {
+		triangle.p1 = pointOf[triangle.p1];
+		triangle.p2 = pointOf[triangle.p2];
+		triangle.p3 = pointOf[triangle.p3];
+	}
+	return static_cast<int>(triangles.size());
+}
+
+/*
+How many problems of each kind verify reported, with the numbers left out
+so that every triangle with the opposite winding counts as one kind;
+the count verify ends with isn't a problem
+*/
+static std::map<std::string, int> problemKinds(const std::vector<std::string> &problems) {
+	std::map<std::string, int> kinds;
+
+	for (auto &problem : problems) {
+		if (problem.find("inner edges checked") != std::string::npos)
+			continue;
+
+		std::istringstream words(problem);
+		std::string kind;
+
+		for (std::string word; words >> word;)
+			if (word != "verify:" && std::find_if(word.begin(), word.end(), ::isdigit) == word.end())
+				kind += (kind.empty() ? "" : " ") + word;
+		kinds[kind]++;
+	}
+
+	return kinds;
+}
+
+int runBenchmark(int maxPoints, const char *engine) {
+	std::vector<std::string> engines;
+	for (auto name : { "incremental", "parallel", "mesh" })
+		if (std::string(engine) == "all" || std::string(engine) == name)
+			engines.push_back(name);
+
+	if (engines.empty()) {
+		std::cout << "Unknown engine " << engine << ", use all, incremental, parallel or mesh" << std::endl;
+		return 1;
+	}
+
+	std::vector<XYZ> points;
+	std::vector<Triangle> triangles;
+	std::vector<std::string> slow; // distribution and engine pairs over TIME_LIMIT
+	long failures = 0, runs = 0;
+
+	std::cout << std::left << std::setw(11) << "points" << std::setw(11) << "input" << std::setw(13) << "engine"
+		<< std::setw(11) << "triangles" << std::setw(11) << "seconds" << std::setw(13) << "points/s"
+		<< std::setw(10) << "peak MB" << "verify" << std::endl;
+
+	for (int pointNumber = 1000; pointNumber <= maxPoints; pointNumber *= 10)
+		for (auto distribution : DISTRIBUTIONS) {
+			makePoints(distribution, pointNumber, points);
+
+			for (auto &name : engines) {
+				std::cout << std::left << std::setw(11) << pointNumber << std::setw(11) << distribution << std::setw(13) << name;
+
+				if (std::find(slow.begin(), slow.end(), distribution + name) != slow.end()) {
+					std::cout << "skipped, over " << TIME_LIMIT << " s on fewer points" << std::endl;
+					continue;
+				}
+
+				// the run's peak is the engine's working memory and the triangles, so the last run's go first
+				std::vector<Triangle>().swap(triangles);
+				auto baseline = resetHeapPeak();
+
+				auto start = std::chrono::steady_clock::now();
+				auto triangleNumber = triangulate(name, points, triangles);
+				std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+				auto peakMegabytes = (heapPeak.load() - baseline) / (1024.0 * 1024.0);
+
+				if (elapsed.count() > TIME_LIMIT)
+					slow.push_back(distribution + name);
+
+				// verify reports every problem, they are kept for after the row
+				std::ostringstream report;
+				auto output = std::cout.rdbuf(report.rdbuf());
+				auto valid = Triangulate::verify(pointNumber, points.data(), triangles.data(), triangleNumber);
+				std::cout.rdbuf(output);
+
+				std::vector<std::string> problems;
+				std::istringstream lines(report.str());
+				for (std::string line; std::getline(lines, line);)
+					problems.push_back(line);
+
+				// none of the point sets is on one line, so no triangles is wrong even if verify lets it pass
+				if (triangleNumber <= 0 && valid) {
+					valid = false;
+					problems.insert(problems.begin(), "no triangles");
+				}
+
+				std::cout << std::setw(11) << triangleNumber << std::setw(11) << std::setprecision(4) << elapsed.count()
+					<< std::setw(13) << std::setprecision(4) << pointNumber / elapsed.count()
+					<< std::setw(10) << std::setprecision(5) << peakMegabytes
+					<< (valid ? "ok" : "FAILED") << std::endl;
+				runs++;
+
+				// how many of each kind, then the first few problems and the count verify ends with
+				if (!valid) {
+					failures++;
+
+					for (auto &kind : problemKinds(problems))
+						std::cout << "    " << std::setw(8) << kind.second << kind.first << std::endl;
+					for (size_t i = 0; i < problems.size(); i++)
+						if (i < 3 || i + 1 == problems.size())
+							std::cout << "    " << problems[i] << std::endl;
+				}
+			}
+		}
+
+	if (failures == 0)
+		std::cout << "Every triangulation verifies" << std::endl;
+	else
+		std::cout << failures << " of " << runs << " triangulations don't verify" << std::endl;
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+/*
+Headless benchmark of the triangulation engines: every engine on every
+point distribution, from 1000 points up to maxPoints by factors of ten,
+printing points per second, triangles, the most heap memory the run took
+on top of the points, and what Triangulate::verify finds. A failed row is
+followed by how many problems of each kind it has; no triangles for a
+point set always fails. engine is "all", "incremental", "parallel" or "mesh".
+It needs nothing but the engines, so the bench project builds it on its
+own without GLFW or GLEW, and lab2 bench runs the same thing.
+The points come from a fixed seed, so runs before and after a change
+triangulate the same input.
+Return 0 when every result verifies
+*/
+int runBenchmark(int maxPoints, const char *engine);
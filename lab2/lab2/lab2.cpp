@@ -4,6 +4,10 @@
 #include <ctime>
 #include <cstdlib>
 #include <vector>
+#include <string>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
 
 // GLEW - OpenGL Extension Wrangler
 #define GLEW_STATIC
@@ -12,386 +16,663 @@
 // GLFW - OpenGL FrameWork
 #include <GLFW/glfw3.h>
 #include "shader.h"
+#include "triangulate.h"
+#include "parallel.h"
+#include "mesh.h"
+#include "meshbuffer.h"
+#include "meshfile.h"
+#include "locator.h"
+#include "benchmark.h"
+#include "voronoi.h"
+#include "profiler.h"
 
 const GLuint WIDTH = 800, HEIGHT = 600;
 const float ORANGE[4] = { 1.0f, 0.549f, 0.0f, 1.0f };
 
+// R reads the shader files again
+auto reloadShaders = false;
+
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode);
-GLFWwindow* initialize();
+GLFWwindow* initialize(bool visible = true);
+int verifyEngines(int pointNumber, int threadNumber);
+int streamPoints(int pointNumber, int updateNumber);
+int refinePolygon(int vertexNumber, double minAngle, double maxArea);
+int renderStream(int pointNumber, int frameNumber, int updateNumber, bool quantized, const char *tracePath);
+int exportMesh(int pointNumber, const char *path, bool compressed);
+int queryMesh(int pointNumber, int queryNumber, int threadNumber);
+int voronoiCells(int pointNumber, int threadNumber);
+
+
+int main(int argc, char *argv[]) {
+	// headless check of both engines: lab2 verify <points> [threads]
+	if (argc > 2 && std::string(argv[1]) == "verify")
+		return verifyEngines(atoi(argv[2]), argc > 3 ? atoi(argv[3]) : 0);
+
+	// update latency of the incremental mesh: lab2 stream <points> [updates]
+	if (argc > 2 && std::string(argv[1]) == "stream")
+		return streamPoints(atoi(argv[2]), argc > 3 ? atoi(argv[3]) : 100000);
+
+	// constrained triangulation and refinement of a polygon: lab2 cdt <vertices> [min angle] [max area]
+	if (argc > 2 && std::string(argv[1]) == "cdt")
+		return refinePolygon(atoi(argv[2]), argc > 3 ? atof(argv[3]) : 30.0, argc > 4 ? atof(argv[4]) : 0.0);
+
+	// upload and frame cost of a changing mesh in a hidden window: lab2 render <points> [frames] [updates per frame] [quantized 0/1] [trace file]
+	if (argc > 2 && std::string(argv[1]) == "render")
+		return renderStream(atoi(argv[2]), argc > 3 ? atoi(argv[3]) : 300, argc > 4 ? atoi(argv[4]) : 100, argc > 5 && atoi(argv[5]) != 0,
+			argc > 6 ? argv[6] : nullptr);
+
+	// write a triangulation to a mesh file and map it back: lab2 export <points> <file> [compressed 0/1]
+	if (argc > 3 && std::string(argv[1]) == "export")
+		return exportMesh(atoi(argv[2]), argv[3], argc > 4 && atoi(argv[4]) != 0);
+
+	// point location, nearest point and interpolation over a triangulation: lab2 query <points> [queries] [threads]
+	if (argc > 2 && std::string(argv[1]) == "query")
+		return queryMesh(atoi(argv[2]), argc > 3 ? atoi(argv[3]) : 1000000, argc > 4 ? atoi(argv[4]) : 0);
+
+	// Voronoi cells and the Delaunay graph of a triangulation: lab2 voronoi <points> [threads]
+	if (argc > 2 && std::string(argv[1]) == "voronoi")
+		return voronoiCells(atoi(argv[2]), argc > 3 ? atoi(argv[3]) : 0);
+
+	// every engine on every point distribution: lab2 bench [max points] [engine]
+	if (argc > 1 && std::string(argv[1]) == "bench")
+		return runBenchmark(argc > 2 ? atoi(argv[2]) : 1000000, argc > 3 ? argv[3] : "all");
 
+	int pointNumber = 10;
 
-class Triangle {
-public:
-	int p1, p2, p3;
+	std::cout << "Creating " << pointNumber << " random points" << std::endl;
 
-	Triangle() { }
-};
+	std::vector<XYZ> points(pointNumber);
+	std::vector<Triangle> triangles;
 
-class Edge {
-public:
-	int p1, p2;
-	Edge() { p1 = -1; p2 = -1; }
-};
+	srand(time(0));
 
-class XYZ {
-public:
-	double x, y, z;
+	for (int i = 0; i < pointNumber; i++) {
+		points[i].x = i * 20.0;
+		points[i].y = rand() % 100 * 2;
+		points[i].z = 0.0;
+	}
 
-	XYZ() { }
+	Triangulate engine;
+	engine.triangulate(points, triangles);
 
-	XYZ(double _x, double _y, double _z) : x(_x), y(_y), z(_z)
-	{}
-};
+	auto window = initialize();
 
-class Triangulate {
+	Shader shader("vertex.txt", "fragment.txt");
+	// the mesh doesn't change, so it is sent once; the shader fits it to the window
+	MeshBuffer buffer;
+	buffer.updatePoints(points);
+	buffer.updateEdges(triangles);
 
-public:
-	static double EPSILON;
+	GLfloat transform[4];
+	buffer.transform(transform);
 
-	/*
-	return TRUE if a point (xPoint,yPoint) is inside the circumcircle made up
-	of the points (x1, y1), (x2, y2), (x3, y3)
-	the circumcircle centre is returned in (xC,yC) and the radius
-	(a point on the edge is inside the circumcircle)
-	*/
-	static bool isInCircle(double xPoint, double yPoint, double x1, double y1,
-		double x2, double y2, double x3, double y3, XYZ *circle) {
+	while (!glfwWindowShouldClose(window)) {
+		glfwPollEvents();
+
+		if (reloadShaders)
+			shader.reload();
+		reloadShaders = false;
+
+		glClearColor(0.7529f, 0.7529f, 0.7529f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+
+		shader.Use();
+		glUniform4fv(shader.uniform("color"), 1, ORANGE);
+		glUniform4fv(shader.uniform("transform"), 1, transform);
+
+		buffer.drawEdges();
+
+		glfwSwapBuffers(window);
+	}
+
+	return 0;
+}
+
+// triangulate the same random points with both engines, time and check them
+int verifyEngines(int pointNumber, int threadNumber) {
+	std::vector<XYZ> points(pointNumber);
+	std::vector<Triangle> triangles(pointNumber * 2);
+	bool valid = true;
 
-		double m1, m2, mx1, mx2, my1, my2;
-		double dx, dy, rsqr, drsqr;
-		double xC, yC, radius;
+	srand(time(0));
+
+	for (int i = 0; i < pointNumber; i++) {
+		points[i].x = rand() / static_cast<double>(RAND_MAX);
+		points[i].y = rand() / static_cast<double>(RAND_MAX);
+		points[i].z = 0.0;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	auto triangleNumber = ParallelTriangulate::triangulate(pointNumber, &points[0], &triangles[0], threadNumber);
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	std::cout << "Divide and conquer: " << triangleNumber << " triangles in " << elapsed.count() << " s" << std::endl;
+	valid = Triangulate::verify(pointNumber, &points[0], &triangles[0], triangleNumber) && valid;
+
+	Triangulate engine;
+
+	start = std::chrono::steady_clock::now();
+	triangleNumber = engine.triangulate(points, triangles);
+	elapsed = std::chrono::steady_clock::now() - start;
+
+	std::cout << "Incremental: " << triangleNumber << " triangles in " << elapsed.count() << " s" << std::endl;
+	valid = Triangulate::verify(pointNumber, &points[0], &triangles[0], triangleNumber) && valid;
+
+	return valid ? 0 : 1;
+}
+
+// build a mesh point by point, then keep replacing random points and time each update
+int streamPoints(int pointNumber, int updateNumber) {
+	DelaunayMesh mesh;
+	std::vector<int> live;
+
+	srand(time(0));
 
-		/* Check for coincident points */
+	auto randomPoint = []() {
+		return XYZ(rand() / static_cast<double>(RAND_MAX), rand() / static_cast<double>(RAND_MAX), 0.0);
+	};
 
-		if (abs(y1 - y2) < EPSILON && abs(y2 - y3) < EPSILON) {
-			std::cout << "isInCircle: points are coincident" << std::endl;
-			return false;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < pointNumber; i++)
+		live.push_back(mesh.insert(randomPoint()));
+	std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+
+	std::cout << "Inserted " << mesh.vertexNumber() << " points, " << elapsed.count() / std::max(pointNumber, 1) << " us per point" << std::endl;
+
+	// with no points there is nothing to replace
+	auto replaced = live.empty() ? 0 : updateNumber;
+
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < replaced; i++) {
+		auto slot = rand() % live.size();
+
+		mesh.remove(live[slot]);
+		live[slot] = mesh.insert(randomPoint());
+	}
+	elapsed = std::chrono::steady_clock::now() - start;
+
+	std::cout << "Replaced " << replaced << " points, " << elapsed.count() / (2.0 * std::max(replaced, 1)) << " us per update" << std::endl;
+
+	// vertices are numbered from 1 and may have gaps, verify wants them packed
+	std::vector<int> packed(mesh.vertexCapacity(), -1);
+	std::vector<XYZ> points;
+	std::vector<Triangle> triangles;
+
+	for (int v = 1; v < mesh.vertexCapacity(); v++)
+		if (mesh.alive(v)) {
+			packed[v] = static_cast<int>(points.size());
+			points.push_back(mesh.vertex(v));
 		}
 
-		if (abs(y2 - y1) < EPSILON) {
-			m2 = -(x3 - x2) / (y3 - y2);
-			mx2 = (x2 + x3) / 2.0;
-			my2 = (y2 + y3) / 2.0;
-			xC = (x2 + x1) / 2.0;
-			yC = m2 * (xC - mx2) + my2;
-		} else
-			if (abs(y3 - y2) < EPSILON) {
-				m1 = -(x2 - x1) / (y2 - y1);
-				mx1 = (x1 + x2) / 2.0;
-				my1 = (y1 + y2) / 2.0;
-				xC = (x3 + x2) / 2.0;
-				yC = m1 * (xC - mx1) + my1;
-			}
-			else {
-				m1 = -(x2 - x1) / (y2 - y1);
-				m2 = -(x3 - x2) / (y3 - y2);
-				mx1 = (x1 + x2) / 2.0;
-				mx2 = (x2 + x3) / 2.0;
-				my1 = (y1 + y2) / 2.0;
-				my2 = (y2 + y3) / 2.0;
-				xC = (m1 * mx1 - m2 * mx2 + my2 - my1) / (m1 - m2);
-				yC = m1 * (xC - mx1) + my1;
-			}
+	mesh.triangles(triangles);
+	for (auto &triangle : triangles) {
+		triangle.p1 = packed[triangle.p1];
+		triangle.p2 = packed[triangle.p2];
+		triangle.p3 = packed[triangle.p3];
+	}
 
-			dx = x2 - xC;
-			dy = y2 - yC;
-			rsqr = dx * dx + dy * dy;
-			radius = sqrt(rsqr);
+	auto linked = mesh.check();
+	return Triangulate::verify(static_cast<int>(points.size()), points.data(), triangles.data(),
+		static_cast<int>(triangles.size())) && linked ? 0 : 1;
+}
 
-			dx = xPoint - xC;
-			dy = yPoint - yC;
-			drsqr = dx * dx + dy * dy;
+/*
+Mesh a wavy polygon of vertexNumber vertices with a wavy hole in it and
+refine it, printing the throughput of both steps and the worst triangle
+*/
+int refinePolygon(int vertexNumber, double minAngle, double maxArea) {
+	const double turn = 8.0 * std::atan(1.0);
+	int holeNumber = std::max(vertexNumber / 8, 8);
 
-			circle->x = xC;
-			circle->y = yC;
-			circle->z = radius;
+	std::vector<XYZ> points;
 
-			return (drsqr <= rsqr ? true : false);
+	for (int i = 0; i < vertexNumber; i++) {
+		auto angle = turn * i / vertexNumber;
+		auto radius = 0.75 + 0.2 * std::sin(7.0 * angle);
+		points.push_back(XYZ(radius * std::cos(angle), radius * std::sin(angle), 0.0));
 	}
 
-	/*
-	Triangulation subroutine
-	Takes as input pointNumb vertices in array xyz
-	These triangles are arranged in a consistent clockwise order.
-	The triangle array "triangle" should be malloced to 3 * pointNumb
-	The vertex array xyz must be big enough to hold 3 more points
-	*/
+	for (int i = 0; i < holeNumber; i++) {
+		auto angle = -turn * i / holeNumber;
+		auto radius = 0.2 + 0.05 * std::sin(5.0 * angle);
+		points.push_back(XYZ(radius * std::cos(angle), radius * std::sin(angle), 0.0));
+	}
 
-	static int triangulate(int pointNumb, XYZ *xyz, Triangle *triangles) {
-		bool *complete;
-		Edge *edges;
-		int edgeNumber = 0;
-		int trianglesMax, edgesMax = pointNumb * 10;
+	std::vector<int> vertex;
+	DelaunayMesh mesh;
 
-		bool inside;
-		double 	xPoint, yPoint, x1, y1, x2, y2, x3, y3, xC, yC, radius;
-		double 	xMin, xMax, yMin, yMax, xMid, yMid;
-		double 	dx, dy, dmax;
+	auto start = std::chrono::steady_clock::now();
+	mesh.insert(points, vertex);
 
-		int	triangleNumber = 0;
+	std::vector<int> outline(vertex.begin(), vertex.begin() + vertexNumber);
+	std::vector<int> hole(vertex.begin() + vertexNumber, vertex.end());
 
-		// allocate memory for the completeness list, flag for each triangle
-		trianglesMax = 4 * pointNumb;
+	for (int i = 0; i < vertexNumber; i++)
+		if (!mesh.insertSegment(outline[i], outline[(i + 1) % vertexNumber]))
+			return 1;
+	for (int i = 0; i < holeNumber; i++)
+		if (!mesh.insertSegment(hole[i], hole[(i + 1) % holeNumber]))
+			return 1;
+	mesh.carve();
 
-		complete = new bool[trianglesMax];
-		for (int i = 0; i < trianglesMax; i++)
-			complete[i] = false;
+	std::vector<Triangle> triangles;
+	mesh.triangles(triangles);
 
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	std::cout << "Constrained: " << triangles.size() << " triangles, " << triangles.size() / elapsed.count() << " triangles per second" << std::endl;
 
-		edges = new Edge[edgesMax];
+	start = std::chrono::steady_clock::now();
+	auto added = mesh.refine(minAngle, maxArea, 100 * (vertexNumber + holeNumber));
+	mesh.triangles(triangles);
+	elapsed = std::chrono::steady_clock::now() - start;
 
+	std::cout << "Refined: " << added << " points added, " << triangles.size() << " triangles, "
+		<< triangles.size() / elapsed.count() << " triangles per second" << std::endl;
 
-		// find the maximum and minimum vertex bounds
-		// this is to allow calculation of the bounding triangle
+	double smallest = 180.0, largest = 0.0;
+	for (auto &triangle : triangles) {
+		const XYZ *corner[3] = { &mesh.vertex(triangle.p1), &mesh.vertex(triangle.p2), &mesh.vertex(triangle.p3) };
 
-		xMin = xyz[0].x;
-		yMin = xyz[0].y;
-		xMax = xMin;
-		yMax = yMin;
+		for (int k = 0; k < 3; k++) {
+			auto &a = *corner[k], &b = *corner[(k + 1) % 3], &c = *corner[(k + 2) % 3];
+			auto cross = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+			auto dot = (b.x - a.x) * (c.x - a.x) + (b.y - a.y) * (c.y - a.y);
 
-		for (int i = 1; i < pointNumb; i++) {
-			if (xyz[i].x < xMin) xMin = xyz[i].x;
-			if (xyz[i].x > xMax) xMax = xyz[i].x;
-			if (xyz[i].y < yMin) yMin = xyz[i].y;
-			if (xyz[i].y > yMax) yMax = xyz[i].y;
+			smallest = std::min(smallest, std::atan2(std::fabs(cross), dot) * 360.0 / turn);
 		}
+		largest = std::max(largest, std::fabs(Triangulate::orientation(*corner[0], *corner[1], *corner[2])) / 2.0);
+	}
 
-		dx = xMax - xMin;
-		dy = yMax - yMin;
-		dmax = (dx > dy) ? dx : dy;
-		xMid = (xMax + xMin) / 2.0;
-		yMid = (yMax + yMin) / 2.0;
-
-		/*
-		Create the supertriangle
-		This is a triangle which encompasses all the sample points
-		The supertriangle coordinates are added to the end of the vertex list
-		The supertriangle is the first triangle in the triangle list
-		*/
-		xyz[pointNumb + 0].x = xMid - 2.0 * dmax;
-		xyz[pointNumb + 0].y = yMid - dmax;
-		xyz[pointNumb + 0].z = 0.0;
-		xyz[pointNumb + 1].x = xMid;
-		xyz[pointNumb + 1].y = yMid + 2.0 * dmax;
-		xyz[pointNumb + 1].z = 0.0;
-		xyz[pointNumb + 2].x = xMid + 2.0 * dmax;
-		xyz[pointNumb + 2].y = yMid - dmax;
-		xyz[pointNumb + 2].z = 0.0;
-		triangles[0].p1 = pointNumb;
-		triangles[0].p2 = pointNumb + 1;
-		triangles[0].p3 = pointNumb + 2;
-
-		complete[0] = false;
-		triangleNumber = 1;
-
-
-
-		// include each point one at a time into the existing mesh
-		for (int i = 0; i < pointNumb; i++) {
-
-			xPoint = xyz[i].x;
-			yPoint = xyz[i].y;
-			edgeNumber = 0;
-
-
-			/*
-			Set up the edge buffer.
-			If the point (xP, yP) lies inside the circumcircle then the
-			three edges of that triangle are added to the edge buffer
-			and that triangle is removed.
-			*/
-			XYZ *circle = new XYZ;
-			for (int j = 0; j < triangleNumber; j++) {
-				if (complete[j])
-					continue;
-
-				x1 = xyz[triangles[j].p1].x;
-				y1 = xyz[triangles[j].p1].y;
-				x2 = xyz[triangles[j].p2].x;
-				y2 = xyz[triangles[j].p2].y;
-				x3 = xyz[triangles[j].p3].x;
-				y3 = xyz[triangles[j].p3].y;
-
-				inside = isInCircle(xPoint, yPoint, x1, y1, x2, y2, x3, y3, circle);
-
-				xC = circle->x; yC = circle->y; radius = circle->z;
-
-				if (xC + radius < xPoint) complete[j] = true;
-
-				if (inside) {
-					// Check that we haven't exceeded the edge list size
-					if (edgeNumber + 3 >= edgesMax) {
-						edgesMax += 100;
-						Edge *edges_n = new Edge[edgesMax];
-
-						edges = edges_n;
-					}
-
-					edges[edgeNumber + 0].p1 = triangles[j].p1;
-					edges[edgeNumber + 0].p2 = triangles[j].p2;
-					edges[edgeNumber + 1].p1 = triangles[j].p2;
-					edges[edgeNumber + 1].p2 = triangles[j].p3;
-					edges[edgeNumber + 2].p1 = triangles[j].p3;
-					edges[edgeNumber + 2].p2 = triangles[j].p1;
-					edgeNumber += 3;
-					triangles[j].p1 = triangles[triangleNumber - 1].p1;
-					triangles[j].p2 = triangles[triangleNumber - 1].p2;
-					triangles[j].p3 = triangles[triangleNumber - 1].p3;
-					complete[j] = complete[triangleNumber - 1];
-					triangleNumber--;
-					j--;
-				}
-			}
+	std::cout << "Smallest angle " << smallest << ", largest area " << largest << std::endl;
+	return 0;
+}
 
+/*
+Keep replacing points of a mesh and draw it every frame into a hidden
+window, printing the frame time and how much of the mesh went to the GPU.
+Quantized, the points go as 16 bit integers instead of floats.
+Given a trace file, the phases of every frame, its GPU time and upload
+counters are written there for chrome://tracing.
+Under Mesa's software rasterizer it runs without a GPU, e.g.
+LIBGL_ALWAYS_SOFTWARE=1 xvfb-run lab2 render 100000
+*/
+int renderStream(int pointNumber, int frameNumber, int updateNumber, bool quantized, const char *tracePath) {
+	DelaunayMesh mesh;
+	std::vector<XYZ> points(pointNumber);
+	std::vector<int> live;
 
-			// tag multiple edges
-			for (int j = 0; j < edgeNumber - 1; j++) {
-				for (int k = j + 1; k < edgeNumber; k++) {
-					if ((edges[j].p1 == edges[k].p2) && (edges[j].p2 == edges[k].p1)) {
-						edges[j].p1 = -1;
-						edges[j].p2 = -1;
-						edges[k].p1 = -1;
-						edges[k].p2 = -1;
-					}
-				}
-			}
+	srand(time(0));
+
+	auto randomPoint = []() {
+		return XYZ(rand() / static_cast<double>(RAND_MAX), rand() / static_cast<double>(RAND_MAX), 0.0);
+	};
+
+	// the program builds while the mesh is made
+	auto window = initialize(false);
+	auto start = std::chrono::steady_clock::now();
+	Shader shader("vertex.txt", "fragment.txt", false);
+	std::chrono::duration<double, std::milli> started = std::chrono::steady_clock::now() - start;
+
+	for (auto &point : points)
+		point = randomPoint();
+	mesh.insert(points, live);
+
+	/*
+	The points by vertex and the triangles by face slot, so that a vertex or
+	a slot that keeps its point or triangle keeps its place in the buffers;
+	an empty slot is a triangle with no area. After the first fill only the
+	vertices and slots the mesh reports as changed are written again
+	*/
+	std::vector<XYZ> vertexPoints;
+	std::vector<Triangle> slots;
+	std::vector<int> changedVertices, changedFaces;
+
+	auto setVertex = [&](int v) {
+		vertexPoints[v] = v > 0 && mesh.alive(v) ? mesh.vertex(v) : XYZ(0.0, 0.0, 0.0);
+	};
+	auto setSlot = [&](int face) {
+		if (!mesh.triangle(face, slots[face]))
+			slots[face].p1 = slots[face].p2 = slots[face].p3 = 0;
+	};
+
+	// FALSE when everything was filled, at the start or after the mesh changed too much to list
+	auto fill = [&](bool all) {
+		auto listed = mesh.takeChanges(changedVertices, changedFaces) && !all;
+
+		vertexPoints.resize(mesh.vertexCapacity());
+		slots.resize(mesh.faceCapacity());
+
+		if (listed) {
+			for (auto v : changedVertices)
+				setVertex(v);
+			for (auto face : changedFaces)
+				setSlot(face);
+			return true;
+		}
 
-			/*
-			Form new triangles for the current point
-			skip any tagged edges.
-			all edges are arranged in clockwise order.
-			*/
-			for (int j = 0; j < edgeNumber; j++) {
-				if (edges[j].p1 == -1 || edges[j].p2 == -1)
-					continue;
-
-				if (triangleNumber >= trianglesMax) return -1;
-				triangles[triangleNumber].p1 = edges[j].p1;
-				triangles[triangleNumber].p2 = edges[j].p2;
-				triangles[triangleNumber].p3 = i;
-
-				complete[triangleNumber] = false;
-				triangleNumber++;
+		for (int v = 0; v < mesh.vertexCapacity(); v++)
+			setVertex(v);
+		for (int face = 0; face < mesh.faceCapacity(); face++)
+			setSlot(face);
+		return false;
+	};
+
+	start = std::chrono::steady_clock::now();
+	shader.finish();
+	std::chrono::duration<double, std::milli> finished = std::chrono::steady_clock::now() - start;
+
+	auto colorLocation = shader.uniform("color");
+	auto transformLocation = shader.uniform("transform");
+
+	MeshBuffer buffer(quantized);
+	buffer.setBounds(0.0, 0.0, 1.0);
+	mesh.trackChanges(true);
+	fill(true);
+	buffer.updatePoints(vertexPoints);
+	buffer.updateEdges(slots);
+
+	GLfloat transform[4];
+	buffer.transform(transform);
+
+	auto firstBytes = buffer.uploadedBytes();
+	auto firstCalls = buffer.uploadCalls();
+	std::chrono::duration<double, std::milli> elapsed(0.0);
+
+	Profiler::nameThread("render");
+	if (tracePath)
+		Profiler::start();
+	Profiler::frame();
+
+	for (int frame = 0; frame < frameNumber; frame++) {
+		{
+			PROFILE_SCOPE("update mesh");
+			for (int i = 0; i < updateNumber && !live.empty(); i++) {
+				auto slot = rand() % live.size();
+
+				mesh.remove(live[slot]);
+				live[slot] = mesh.insert(randomPoint());
 			}
 		}
+		bool listed;
+		{
+			PROFILE_SCOPE("fill");
+			listed = fill(false);
+		}
+
+		start = std::chrono::steady_clock::now();
+		auto frameBytes = buffer.uploadedBytes();
+		auto frameCalls = buffer.uploadCalls();
+
+		Profiler::gpuBegin("upload and draw");
+		{
+			PROFILE_SCOPE("draw");
+			glClearColor(0.7529f, 0.7529f, 0.7529f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT);
 
+			shader.Use();
+			glUniform4fv(colorLocation, 1, ORANGE);
+			glUniform4fv(transformLocation, 1, transform);
 
-		/*
-		Remove triangles with supertriangle vertices
-		These are triangles which have a vertex number greater than pointNumb
-		*/
-		for (int i = 0; i < triangleNumber; i++) {
-			if (triangles[i].p1 >= pointNumb || triangles[i].p2 >= pointNumb || triangles[i].p3 >= pointNumb) {
-				triangles[i] = triangles[triangleNumber - 1];
-				triangleNumber--;
-				i--;
+			if (listed) {
+				buffer.updatePoints(vertexPoints, changedVertices);
+				buffer.updateEdges(slots, changedFaces);
 			}
+			else {
+				buffer.updatePoints(vertexPoints);
+				buffer.updateEdges(slots);
+			}
+			buffer.drawEdges();
+		}
+		Profiler::gpuEnd();
+		Profiler::count("uploaded bytes", buffer.uploadedBytes() - frameBytes);
+		Profiler::count("upload ranges", buffer.uploadCalls() - frameCalls);
+
+		{
+			PROFILE_SCOPE("swap");
+			glfwSwapBuffers(window);
+			glFinish();
 		}
 
-		return triangleNumber;
+		elapsed += std::chrono::steady_clock::now() - start;
+		Profiler::collect();
+		Profiler::frame();
 	}
-};
 
-double Triangulate::EPSILON = 0.000001;
+	auto sent = (buffer.uploadedBytes() - firstBytes) / static_cast<double>(frameNumber);
+
+	// what the same triangles take as nine floats each, the way lab2 drew them before
+	auto unindexed = 9 * sizeof(GLfloat) * mesh.triangleNumber();
+
+	std::cout << "Program " << (shader.cached() ? "loaded from the cache" : "compiled") << ": " << started.count()
+		<< " ms to start, " << finished.count() << " ms more to finish after the mesh" << std::endl;
+	std::cout << (buffer.persistent() ? "Persistent mapped buffer: " : "Buffer sub data: ")
+		<< elapsed.count() / frameNumber << " ms per frame, "
+		<< sent / 1024.0 << " KB in " << (buffer.uploadCalls() - firstCalls) / static_cast<double>(frameNumber)
+		<< " ranges per frame, " << buffer.pointBytes() / 1024.0 << " KB of points and "
+		<< buffer.indexBytes() / 1024.0 << " KB of indices, " << buffer.indexBytes() / std::max(mesh.triangleNumber(), 1)
+		<< " bytes a triangle (" << unindexed / 1024.0 << " KB as nine floats a triangle)" << std::endl;
+	std::cout << Profiler::histogram();
+
+	if (tracePath) {
+		Profiler::stop();
+		if (Profiler::write(tracePath))
+			std::cout << "Trace written to " << tracePath << std::endl;
+	}
 
-int main() {
-	int pointNumber = 10;
-	float max = FLT_MIN;
+	glfwTerminate();
+	return glGetError() == GL_NO_ERROR ? 0 : 1;
+}
 
-	std::vector<float> coord;
+// time writing a triangulation with its neighbours and reading it back, and check the copy
+int exportMesh(int pointNumber, const char *path, bool compressed) {
+	std::vector<XYZ> points(pointNumber);
+	std::vector<Triangle> triangles(pointNumber * 2);
 
-	std::cout << "Creating " << pointNumber << " random points" << std::endl;
+	srand(time(0));
+	for (auto &point : points)
+		point = XYZ(rand() / static_cast<double>(RAND_MAX), rand() / static_cast<double>(RAND_MAX), 0.0);
+
+	auto start = std::chrono::steady_clock::now();
+	triangles.resize(ParallelTriangulate::triangulate(pointNumber, points.data(), triangles.data()));
+	std::chrono::duration<double> triangulated = std::chrono::steady_clock::now() - start;
+
+	auto flags = MeshWriter::ADJACENCY | (compressed ? MeshWriter::COMPRESSED : 0);
+
+	start = std::chrono::steady_clock::now();
+	if (!MeshWriter::write(path, points, triangles, flags))
+		return 1;
+	std::chrono::duration<double> written = std::chrono::steady_clock::now() - start;
+
+	MeshReader reader;
+
+	start = std::chrono::steady_clock::now();
+	if (!reader.open(path))
+		return 1;
+	std::chrono::duration<double> read = std::chrono::steady_clock::now() - start;
+
+	auto same = reader.pointNumber() == points.size() && reader.triangleNumber() == triangles.size()
+		&& std::equal(points.begin(), points.end(), reader.points(),
+			[](const XYZ &a, const XYZ &b) { return a.x == b.x && a.y == b.y && a.z == b.z; })
+		&& std::equal(triangles.begin(), triangles.end(), reader.triangles(),
+			[](const Triangle &a, const Triangle &b) { return a.p1 == b.p1 && a.p2 == b.p2 && a.p3 == b.p3; });
+
+	// a neighbour has to hold both ends of the edge it is across
+	auto neighbours = reader.neighbours();
+	for (size_t t = 0; same && t < reader.triangleNumber(); t++) {
+		auto &triangle = reader.triangles()[t];
+		int corner[3] = { triangle.p1, triangle.p2, triangle.p3 };
+
+		for (int k = 0; k < 3; k++) {
+			auto n = neighbours[3 * t + k];
+			if (n < 0)
+				continue;
+
+			auto &other = reader.triangles()[n];
+			for (auto v : { corner[k], corner[(k + 1) % 3] })
+				same = same && (other.p1 == v || other.p2 == v || other.p3 == v);
+		}
+	}
 
-	XYZ *points = new XYZ[pointNumber + 3];
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	auto bytes = static_cast<double>(file.tellg());
+
+	std::cout << triangles.size() << " triangles: triangulated in " << triangulated.count() << " s, written in "
+		<< written.count() << " s, mapped in " << read.count() * 1000.0 << " ms, "
+		<< bytes / (1024.0 * 1024.0) << " MB (" << bytes / std::max<size_t>(triangles.size(), 1) << " bytes a triangle)"
+		<< (same ? ", read back the same" : ", READ BACK DIFFERENT") << std::endl;
+
+	return same ? 0 : 1;
+}
+
+/*
+Time batches of queries over a triangulation of random points and check
+a sample of them against a scan of every triangle and point.
+The value interpolated is linear, so it has to come back exactly
+*/
+int queryMesh(int pointNumber, int queryNumber, int threadNumber) {
+	std::vector<XYZ> points(pointNumber), queries(queryNumber);
+	std::vector<Triangle> triangles(pointNumber * 2);
+	std::vector<double> values(pointNumber);
 
 	srand(time(0));
+	auto random = []() { return rand() / static_cast<double>(RAND_MAX); };
 
-	for (int i = 0; i < pointNumber + 3; i++) {
-		points[i].x = i * 20.0;
-		points[i].y = rand() % 100 * 2;
-		points[i].z = 0.0;
+	for (int i = 0; i < pointNumber; i++) {
+		points[i] = XYZ(random(), random(), 0.0);
+		values[i] = 3.0 * points[i].x - 2.0 * points[i].y;
 	}
 
-	Triangle *triangles = new Triangle[pointNumber * 3];
+	// a few queries fall outside the points
+	for (auto &query : queries)
+		query = XYZ(random() * 1.1 - 0.05, random() * 1.1 - 0.05, 0.0);
 
-	int triangleNumber = Triangulate::triangulate(pointNumber, points, triangles);
+	triangles.resize(ParallelTriangulate::triangulate(pointNumber, points.data(), triangles.data()));
 
+	auto start = std::chrono::steady_clock::now();
+	PointLocator locator(pointNumber, points.data(), triangles.data(), static_cast<int>(triangles.size()));
+	std::chrono::duration<double> built = std::chrono::steady_clock::now() - start;
 
-	for (int i = 0; i < triangleNumber; i++) {
-		coord.push_back(static_cast<float>(points[triangles[i].p1].x));
-		coord.push_back(static_cast<float>(points[triangles[i].p1].y));
-		coord.push_back(static_cast<float>(0.0f));
+	std::vector<int> located, nearest;
+	std::vector<double> interpolated;
 
-		coord.push_back(static_cast<float>(points[triangles[i].p2].x));
-		coord.push_back(static_cast<float>(points[triangles[i].p2].y));
-		coord.push_back(static_cast<float>(0.0f));
+	auto rate = [&](std::chrono::steady_clock::time_point since) {
+		return queryNumber / std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+	};
 
-		coord.push_back(static_cast<float>(points[triangles[i].p3].x));
-		coord.push_back(static_cast<float>(points[triangles[i].p3].y));
-		coord.push_back(static_cast<float>(0.0f));
-	}
+	start = std::chrono::steady_clock::now();
+	locator.locate(queries, located, threadNumber);
+	auto locateRate = rate(start);
 
-	for (auto iter = coord.begin(); iter != coord.end(); ++iter)
-		if (*iter > max)
-			max = *iter;
+	start = std::chrono::steady_clock::now();
+	locator.nearest(queries, nearest, threadNumber);
+	auto nearestRate = rate(start);
 
-	for (auto i = 0; i < coord.size(); i++) {
-		coord[i] /= max;
-		coord[i] -= 0.5;
-		coord[i] *= 2;
-	}
+	start = std::chrono::steady_clock::now();
+	locator.interpolate(queries, values, interpolated, threadNumber);
+	auto interpolateRate = rate(start);
 
-	auto window = initialize();
+	std::cout << triangles.size() << " triangles, index built in " << built.count() << " s; queries per second: "
+		<< locateRate << " locate, " << nearestRate << " nearest, " << interpolateRate << " interpolate" << std::endl;
 
-	Shader shader("vertex.txt", "fragment.txt");
+	// a sample small enough to scan for
+	auto sample = std::min(queryNumber, std::max(20, static_cast<int>(100000000 / (triangles.size() + 1))));
+	long errors = 0;
 
-	GLuint VAO;
-	GLuint VBO;
+	for (int q = 0; q < sample; q++) {
+		auto &query = queries[q];
+		auto contains = [&](const Triangle &triangle) {
+			auto &a = points[triangle.p1], &b = points[triangle.p2], &c = points[triangle.p3];
+			auto winding = Triangulate::orientation(a, b, c) > 0.0 ? 1.0 : -1.0;
 
-	while (!glfwWindowShouldClose(window)) {
-		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+			return Triangulate::orientation(a, b, query) * winding >= 0.0 && Triangulate::orientation(b, c, query) * winding >= 0.0
+				&& Triangulate::orientation(c, a, query) * winding >= 0.0;
+		};
 
-		glfwPollEvents();
+		auto outside = std::none_of(triangles.begin(), triangles.end(), contains);
+		if (located[q] < 0 ? !outside : !contains(triangles[located[q]]))
+			errors++;
 
-		glClearColor(0.7529f, 0.7529f, 0.7529f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
+		auto distance = [&](const XYZ &point) { return (point.x - query.x) * (point.x - query.x) + (point.y - query.y) * (point.y - query.y); };
+		auto closest = std::min_element(points.begin(), points.end(),
+			[&](const XYZ &a, const XYZ &b) { return distance(a) < distance(b); });
+		if (nearest[q] < 0 || distance(points[nearest[q]]) != distance(*closest))
+			errors++;
 
-		auto colorLocation = glGetUniformLocation(shader.Program, "color");
-		glUniform4fv(colorLocation, 1, ORANGE);
+		auto exact = 3.0 * query.x - 2.0 * query.y;
+		if (located[q] < 0 ? !std::isnan(interpolated[q]) : std::fabs(interpolated[q] - exact) > 1e-9)
+			errors++;
+	}
 
-		shader.Use();
+	std::cout << (errors == 0 ? "Sample matches a full scan" : "Sample has errors: ") << (errors == 0 ? "" : std::to_string(errors)) << std::endl;
+	return errors == 0 ? 0 : 1;
+}
 
-		glGenVertexArrays(1, &VAO);
-		glGenBuffers(1, &VBO);
+/*
+Time the dual of a triangulation of random points in the unit square and
+check it: the cells clipped to the square cover it exactly, each holds its
+own point and is closer to it than to any of its neighbours, and the
+neighbours go both ways
+*/
+int voronoiCells(int pointNumber, int threadNumber) {
+	std::vector<XYZ> points(pointNumber);
+	std::vector<Triangle> triangles(pointNumber * 2);
 
-		glBindVertexArray(VAO);
+	srand(time(0));
+	for (auto &point : points)
+		point = XYZ(rand() / static_cast<double>(RAND_MAX), rand() / static_cast<double>(RAND_MAX), 0.0);
 
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferData(GL_ARRAY_BUFFER, coord.size() * sizeof(GLfloat), &coord[0], GL_STATIC_DRAW);
+	triangles.resize(ParallelTriangulate::triangulate(pointNumber, points.data(), triangles.data()));
 
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), static_cast<GLvoid*>(nullptr));
-		glEnableVertexAttribArray(0);
+	auto start = std::chrono::steady_clock::now();
+	VoronoiDiagram diagram(pointNumber, points.data(), triangles.data(), static_cast<int>(triangles.size()), 0.0, 0.0, 1.0, 1.0, threadNumber);
+	std::chrono::duration<double> built = std::chrono::steady_clock::now() - start;
 
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindVertexArray(0);
+	long errors = 0;
+	auto area = 0.0;
 
-		glBindVertexArray(VAO);
-		glDrawArrays(GL_TRIANGLES, 0, coord.size());
-		glBindVertexArray(0);
+	for (int v = 0; v < pointNumber; v++) {
+		auto cell = diagram.cell(v);
+		auto size = diagram.cellSize(v);
 
-		glBindVertexArray(0);
-		glfwSwapBuffers(window);
+		for (int k = 0; k < size; k++) {
+			auto &a = cell[k], &b = cell[(k + 1) % size];
+			area += (a.x * b.y - b.x * a.y) / 2.0;
+
+			if (Triangulate::orientation(a, b, points[v]) < -1e-12)
+				errors++;
+
+			// a corner of the cell is as far from v as from the nearest neighbour, no nearer
+			auto distance = [&](const XYZ &point) { return (point.x - a.x) * (point.x - a.x) + (point.y - a.y) * (point.y - a.y); };
+			for (int n = 0; n < diagram.neighbourNumber(v); n++)
+				if (distance(points[diagram.neighbours(v)[n]]) < distance(points[v]) - 1e-9)
+					errors++;
+		}
+
+		for (int n = 0; n < diagram.neighbourNumber(v); n++) {
+			auto u = diagram.neighbours(v)[n];
+			if (std::find(diagram.neighbours(u), diagram.neighbours(u) + diagram.neighbourNumber(u), v) == diagram.neighbours(u) + diagram.neighbourNumber(u))
+				errors++;
+		}
 	}
 
-	return 0;
+	if (std::fabs(area - 1.0) > 1e-9)
+		errors++;
+
+	std::cout << triangles.size() << " triangles: " << diagram.neighbours().size() / 2 << " Delaunay edges and "
+		<< diagram.cells().size() << " cell corners in " << built.count() << " s (" << pointNumber / built.count()
+		<< " points/s), cells cover " << area << " of the square" << std::endl;
+	std::cout << (errors == 0 ? "Every cell checks out" : "Cells with errors: ") << (errors == 0 ? "" : std::to_string(errors)) << std::endl;
+
+	return errors == 0 ? 0 : 1;
 }
 
-GLFWwindow* initialize() {
+GLFWwindow* initialize(bool visible) {
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+	glfwWindowHint(GLFW_VISIBLE, visible ? GL_TRUE : GL_FALSE);
 
 	auto window = glfwCreateWindow(WIDTH, HEIGHT, "Polygon Intersection", nullptr, nullptr);
 	glfwMakeContextCurrent(window);
@@ -408,4 +689,6 @@ GLFWwindow* initialize() {
 void key_callback(GLFWwindow* window, int key, int, int action, int) {
 	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, GL_TRUE);
+	if (key == GLFW_KEY_R && action == GLFW_PRESS)
+		reloadShaders = true;
 }
@@ -0,0 +1,349 @@
+#include "locator.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+PointLocator::PointLocator(int pointNumb, const XYZ *xyz, const Triangle *triangles, int triangleNumber)
+	: pointNumb(pointNumb), xyz(xyz), triangles(triangles), triangleNumber(triangleNumber), winding(1.0), convex(true), gridSize(0) {
+
+	if (triangleNumber <= 0)
+		return;
+
+	Triangulate::neighbours(triangles, triangleNumber, neighbours);
+
+	for (int t = 0; t < triangleNumber; t++) {
+		auto area = Triangulate::orientation(xyz[triangles[t].p1], xyz[triangles[t].p2], xyz[triangles[t].p3]);
+		if (area != 0.0) {
+			winding = area > 0.0 ? 1.0 : -1.0;
+			break;
+		}
+	}
+
+	// every edge goes in the rings of both ends: an inner one from each side, a hull one twice from its only side
+	first.assign(pointNumb + 1, 0);
+	for (int t = 0; t < triangleNumber; t++) {
+		int corner[3] = { triangles[t].p1, triangles[t].p2, triangles[t].p3 };
+
+		for (int k = 0; k < 3; k++) {
+			first[corner[k] + 1]++;
+			if (neighbours[3 * t + k] < 0)
+				first[corner[(k + 1) % 3] + 1]++;
+		}
+	}
+	for (int v = 0; v < pointNumb; v++)
+		first[v + 1] += first[v];
+
+	ring.resize(first[pointNumb]);
+	std::vector<int> fill(first.begin(), first.end() - 1);
+
+	for (int t = 0; t < triangleNumber; t++) {
+		int corner[3] = { triangles[t].p1, triangles[t].p2, triangles[t].p3 };
+
+		for (int k = 0; k < 3; k++) {
+			auto a = corner[k], b = corner[(k + 1) % 3];
+
+			ring[fill[a]++] = b;
+			if (neighbours[3 * t + k] < 0)
+				ring[fill[b]++] = a;
+		}
+	}
+
+	/*
+	The boundary is convex if it is a single loop that never turns the wrong
+	way. Nothing else is (holes, or a vertex two hull edges leave, as the mesh
+	engine can leave behind after removals), and a walk that leaves through
+	a hull edge then has to scan before it can call the point outside
+	*/
+	std::vector<int> hullNext(pointNumb, -1);
+	auto hullEdges = 0;
+
+	convex = true;
+	for (int t = 0; t < triangleNumber && convex; t++) {
+		int corner[3] = { triangles[t].p1, triangles[t].p2, triangles[t].p3 };
+
+		for (int k = 0; k < 3; k++)
+			if (neighbours[3 * t + k] < 0) {
+				convex = convex && hullNext[corner[k]] < 0;
+				hullNext[corner[k]] = corner[(k + 1) % 3];
+				hullEdges++;
+			}
+	}
+
+	if (convex && hullEdges > 0) {
+		auto start = 0;
+		while (hullNext[start] < 0)
+			start++;
+
+		auto loop = 0, a = start;
+		do {
+			auto b = hullNext[a], c = b >= 0 ? hullNext[b] : -1;
+
+			convex = c >= 0 && Triangulate::orientation(xyz[a], xyz[b], xyz[c]) * winding >= 0.0;
+			a = b;
+			loop++;
+		} while (convex && a != start && loop <= hullEdges);
+
+		convex = convex && loop == hullEdges;
+	}
+
+	// about two triangles a cell
+	double xMin = xyz[triangles[0].p1].x, xMax = xMin, yMin = xyz[triangles[0].p1].y, yMax = yMin;
+	for (int v = 0; v < pointNumb; v++)
+		if (first[v + 1] > first[v]) {
+			xMin = std::min(xMin, xyz[v].x);
+			xMax = std::max(xMax, xyz[v].x);
+			yMin = std::min(yMin, xyz[v].y);
+			yMax = std::max(yMax, xyz[v].y);
+		}
+
+	gridSize = std::max(1, static_cast<int>(std::sqrt(triangleNumber / 2.0)));
+	gridX = xMin;
+	gridY = yMin;
+	gridStep = std::max(xMax - xMin, yMax - yMin) / gridSize;
+	if (gridStep <= 0.0)
+		gridStep = 1.0;
+
+	// without a convex hull, every triangle is listed in the cells its bounding box covers for the scan
+	if (!convex) {
+		cellFirst.assign(gridSize * gridSize + 1, 0);
+
+		for (int pass = 0; pass < 2; pass++) {
+			std::vector<int> fill(cellFirst.begin(), cellFirst.end() - 1);
+
+			for (int t = 0; t < triangleNumber; t++) {
+				auto &a = xyz[triangles[t].p1], &b = xyz[triangles[t].p2], &c = xyz[triangles[t].p3];
+				auto low = cell(XYZ(std::min(a.x, std::min(b.x, c.x)), std::min(a.y, std::min(b.y, c.y)), 0.0));
+				auto high = cell(XYZ(std::max(a.x, std::max(b.x, c.x)), std::max(a.y, std::max(b.y, c.y)), 0.0));
+
+				for (int row = low / gridSize; row <= high / gridSize; row++)
+					for (int column = low % gridSize; column <= high % gridSize; column++)
+						if (pass == 0)
+							cellFirst[row * gridSize + column + 1]++;
+						else
+							cellTriangles[fill[row * gridSize + column]++] = t;
+			}
+
+			if (pass == 0) {
+				for (int i = 0; i < gridSize * gridSize; i++)
+					cellFirst[i + 1] += cellFirst[i];
+				cellTriangles.resize(cellFirst.back());
+			}
+		}
+	}
+
+	// the seed of each cell is where a walk to its centre from the one before ends, row by row, back and forth
+	seeds.resize(gridSize * gridSize);
+
+	auto current = 0;
+	unsigned random = 2463534242u;
+	bool inside;
+
+	for (int row = 0; row < gridSize; row++)
+		for (int i = 0; i < gridSize; i++) {
+			auto column = row % 2 == 0 ? i : gridSize - 1 - i;
+			XYZ centre(gridX + (column + 0.5) * gridStep, gridY + (row + 0.5) * gridStep, 0.0);
+
+			current = walk(centre, current, random, inside);
+			seeds[row * gridSize + column] = current;
+		}
+}
+
+// the grid cell of point, the nearest one if point is off the grid
+int PointLocator::cell(const XYZ &point) const {
+	auto column = static_cast<int>(std::min(std::max((point.x - gridX) / gridStep, 0.0), gridSize - 1.0));
+	auto row = static_cast<int>(std::min(std::max((point.y - gridY) / gridStep, 0.0), gridSize - 1.0));
+
+	return row * gridSize + column;
+}
+
+int PointLocator::seed(const XYZ &point) const {
+	return seeds[cell(point)];
+}
+
+/*
+Step to the neighbour across an edge that has point strictly on its far
+side until there is none (point is in the triangle) or the edge is on the
+hull, never stepping back across the edge just crossed.
+Past the hull of a convex triangulation the point is outside; otherwise
+it may be in a triangle the walk can't reach, so every triangle is checked
+*/
+int PointLocator::walk(const XYZ &point, int start, unsigned &random, bool &inside) const {
+	auto current = start, previous = -1;
+
+	for (int steps = 0; steps <= triangleNumber; steps++) {
+		int corner[3] = { triangles[current].p1, triangles[current].p2, triangles[current].p3 };
+
+		random ^= random << 13;
+		random ^= random >> 17;
+		random ^= random << 5;
+
+		auto k0 = static_cast<int>(random % 3);
+		auto next = current;
+
+		for (int i = 0; i < 3 && next == current; i++) {
+			auto k = (k0 + i) % 3;
+			auto neighbour = neighbours[3 * current + k];
+
+			if (neighbour == previous && neighbour >= 0)
+				continue;
+
+			if (Triangulate::orientation(xyz[corner[k]], xyz[corner[(k + 1) % 3]], point) * winding < 0.0) {
+				if (neighbour < 0) {
+					if (convex) {
+						inside = false;
+						return current;
+					}
+					return scan(point, current, inside);
+				}
+				next = neighbour;
+			}
+		}
+
+		if (next == current) {
+			inside = true;
+			return current;
+		}
+
+		previous = current;
+		current = next;
+	}
+
+	// only a broken triangulation gets here
+	return scan(point, start, inside);
+}
+
+/*
+the first triangle holding point, or fallback with inside FALSE if there
+is none; only the triangles listed in the cell of point if there are lists
+*/
+int PointLocator::scan(const XYZ &point, int fallback, bool &inside) const {
+	auto listed = !cellFirst.empty();
+	auto begin = listed ? cellFirst[cell(point)] : 0, end = listed ? cellFirst[cell(point) + 1] : triangleNumber;
+
+	for (int i = begin; i < end; i++) {
+		auto t = listed ? cellTriangles[i] : i;
+		int corner[3] = { triangles[t].p1, triangles[t].p2, triangles[t].p3 };
+		auto in = true;
+
+		for (int k = 0; k < 3 && in; k++)
+			in = Triangulate::orientation(xyz[corner[k]], xyz[corner[(k + 1) % 3]], point) * winding >= 0.0;
+
+		if (in) {
+			inside = true;
+			return t;
+		}
+	}
+
+	inside = false;
+	return fallback;
+}
+
+int PointLocator::locate(const XYZ &point, unsigned &random, bool &inside) const {
+	inside = false;
+	if (triangleNumber <= 0)
+		return -1;
+
+	return walk(point, seed(point), random, inside);
+}
+
+int PointLocator::nearest(const XYZ &point, unsigned &random) const {
+	bool inside;
+	auto triangle = locate(point, random, inside);
+
+	if (triangle < 0)
+		return -1;
+
+	auto distance = [&](int v) {
+		auto dx = xyz[v].x - point.x, dy = xyz[v].y - point.y;
+		return dx * dx + dy * dy;
+	};
+
+	// the closest corner of the triangle the walk ended in, then closer and closer neighbours
+	int corner[3] = { triangles[triangle].p1, triangles[triangle].p2, triangles[triangle].p3 };
+	auto best = corner[0];
+	auto bestDistance = distance(best);
+
+	for (int k = 1; k < 3; k++)
+		if (distance(corner[k]) < bestDistance) {
+			best = corner[k];
+			bestDistance = distance(best);
+		}
+
+	for (auto moved = true; moved;) {
+		moved = false;
+
+		for (int i = first[best], end = first[best + 1]; i < end; i++)
+			if (distance(ring[i]) < bestDistance) {
+				best = ring[i];
+				bestDistance = distance(best);
+				moved = true;
+				break;
+			}
+	}
+
+	return best;
+}
+
+int PointLocator::locate(const XYZ &point) const {
+	unsigned random = 2463534242u;
+	bool inside;
+	auto triangle = locate(point, random, inside);
+
+	return inside ? triangle : -1;
+}
+
+int PointLocator::nearest(const XYZ &point) const {
+	unsigned random = 2463534242u;
+	return nearest(point, random);
+}
+
+bool PointLocator::interpolate(const XYZ &point, const double *values, double &result) const {
+	auto triangle = locate(point);
+	if (triangle < 0)
+		return false;
+
+	auto &a = xyz[triangles[triangle].p1], &b = xyz[triangles[triangle].p2], &c = xyz[triangles[triangle].p3];
+	auto area = Triangulate::orientation(a, b, c);
+
+	// each corner weighs as much as the triangle the point makes with the opposite edge
+	result = (Triangulate::orientation(point, b, c) * values[triangles[triangle].p1]
+		+ Triangulate::orientation(a, point, c) * values[triangles[triangle].p2]
+		+ Triangulate::orientation(a, b, point) * values[triangles[triangle].p3]) / area;
+	return true;
+}
+
+void PointLocator::locate(const std::vector<XYZ> &points, std::vector<int> &result, int threadNumber) const {
+	result.resize(points.size());
+
+	inParallel(points.size(), threadNumber, [&](size_t begin, size_t end) {
+		unsigned random = 2463534242u ^ static_cast<unsigned>(begin);
+		bool inside;
+
+		for (auto i = begin; i < end; i++) {
+			auto triangle = locate(points[i], random, inside);
+			result[i] = inside ? triangle : -1;
+		}
+	});
+}
+
+void PointLocator::nearest(const std::vector<XYZ> &points, std::vector<int> &result, int threadNumber) const {
+	result.resize(points.size());
+
+	inParallel(points.size(), threadNumber, [&](size_t begin, size_t end) {
+		unsigned random = 2463534242u ^ static_cast<unsigned>(begin);
+
+		for (auto i = begin; i < end; i++)
+			result[i] = nearest(points[i], random);
+	});
+}
+
+void PointLocator::interpolate(const std::vector<XYZ> &points, const std::vector<double> &values, std::vector<double> &result, int threadNumber) const {
+	result.resize(points.size());
+
+	inParallel(points.size(), threadNumber, [&](size_t begin, size_t end) {
+		for (auto i = begin; i < end; i++)
+			if (!interpolate(points[i], values.data(), result[i]))
+				result[i] = std::numeric_limits<double>::quiet_NaN();
+	});
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <vector>
+#include "triangulate.h"
+
+/*
+Point queries over a finished triangulation, as both engines give it or
+a MeshReader maps it: the arrays are used in place and must outlive the locator.
+A query walks from the triangle kept for its cell of a square grid over
+the points towards the point, one neighbour at a time, choosing the first
+edge to try at random so the walk can't circle. A walk that leaves
+through the hull ends there if the hull is convex, as it is for a
+Delaunay triangulation; for any other boundary the point is looked for
+in the triangles over its grid cell before it is called outside. The nearest point is
+then found by moving to closer neighbours along the Delaunay edges,
+which only stops at the nearest one.
+The batch versions split the queries over threadNumber threads, 0 for
+every hardware thread
+*/
+class PointLocator {
+public:
+	PointLocator(int pointNumb, const XYZ *xyz, const Triangle *triangles, int triangleNumber);
+
+	// the triangle holding point, -1 if it is outside the triangulation
+	int locate(const XYZ &point) const;
+
+	// the vertex closest to point, -1 if there are no triangles
+	int nearest(const XYZ &point) const;
+
+	// the value at point interpolated linearly from the values at the vertices, FALSE outside the triangulation
+	bool interpolate(const XYZ &point, const double *values, double &result) const;
+
+	void locate(const std::vector<XYZ> &points, std::vector<int> &result, int threadNumber = 0) const;
+	void nearest(const std::vector<XYZ> &points, std::vector<int> &result, int threadNumber = 0) const;
+
+	// NaN outside the triangulation
+	void interpolate(const std::vector<XYZ> &points, const std::vector<double> &values, std::vector<double> &result, int threadNumber = 0) const;
+
+private:
+	int pointNumb;
+	const XYZ *xyz;
+	const Triangle *triangles;
+	int triangleNumber;
+	double winding; // 1 when the triangles are counterclockwise, -1 when clockwise
+	bool convex; // the hull edges make one loop that never turns against the winding
+
+	std::vector<int> neighbours; // as Triangulate::neighbours gives them
+
+	// the vertices next to each vertex: ring[first[v]] to ring[first[v + 1]]
+	std::vector<int> first, ring;
+
+	std::vector<int> seeds;
+	int gridSize;
+	double gridX, gridY, gridStep;
+
+	// without a convex hull, the triangles over each cell: cellTriangles[cellFirst[c]] to cellTriangles[cellFirst[c + 1]]
+	std::vector<int> cellFirst, cellTriangles;
+
+	int cell(const XYZ &point) const;
+	int seed(const XYZ &point) const;
+	int walk(const XYZ &point, int start, unsigned &random, bool &inside) const;
+	int scan(const XYZ &point, int fallback, bool &inside) const;
+	int locate(const XYZ &point, unsigned &random, bool &inside) const;
+	int nearest(const XYZ &point, unsigned &random) const;
+};
@@ -0,0 +1,1123 @@
+#include "mesh.h"
+#include <algorithm>
+
+const int DelaunayMesh::INFINITE;
+const int DelaunayMesh::FREE;
+const int DelaunayMesh::PENDING;
+
+DelaunayMesh::DelaunayMesh() : liveVertices(0), finiteFaces(0), lastFace(-1), gridSize(0),
+	tracking(false), changedAll(false), stamp(0), random(2463534242u) {
+	// slot 0 is the vertex at infinity
+	vertices.push_back(XYZ(0.0, 0.0, 0.0));
+	vertexFace.push_back(PENDING);
+}
+
+int DelaunayMesh::newVertex(const XYZ &point) {
+	int vertex;
+
+	if (!freeVertices.empty()) {
+		vertex = freeVertices.back();
+		freeVertices.pop_back();
+		vertices[vertex] = point;
+	}
+	else {
+		vertex = static_cast<int>(vertices.size());
+		vertices.push_back(point);
+		vertexFace.push_back(FREE);
+	}
+
+	liveVertices++;
+	if (tracking)
+		changedVertexList.push_back(vertex);
+	return vertex;
+}
+
+void DelaunayMesh::freeVertex(int vertex) {
+	vertexFace[vertex] = FREE;
+	freeVertices.push_back(vertex);
+	liveVertices--;
+	if (tracking)
+		changedVertexList.push_back(vertex);
+}
+
+int DelaunayMesh::newFace(int a, int b, int c) {
+	int face;
+
+	if (!freeFaces.empty()) {
+		face = freeFaces.back();
+		freeFaces.pop_back();
+	}
+	else {
+		face = static_cast<int>(faces.size());
+		faces.push_back(Face());
+		faceMark.push_back(0);
+	}
+
+	auto &f = faces[face];
+	f.v[0] = a;
+	f.v[1] = b;
+	f.v[2] = c;
+	f.n[0] = f.n[1] = f.n[2] = -1;
+	f.fixed = 0;
+	f.exterior = false;
+
+	vertexFace[a] = face;
+	vertexFace[b] = face;
+	vertexFace[c] = face;
+
+	if (!isGhost(face))
+		finiteFaces++;
+	lastFace = face;
+	if (tracking)
+		changedFaceList.push_back(face);
+
+	return face;
+}
+
+void DelaunayMesh::freeFace(int face) {
+	if (!isGhost(face))
+		finiteFaces--;
+
+	faces[face].v[0] = -1;
+	freeFaces.push_back(face);
+	if (tracking)
+		changedFaceList.push_back(face);
+}
+
+bool DelaunayMesh::isGhost(int face) const {
+	auto &f = faces[face];
+	return f.v[0] == INFINITE || f.v[1] == INFINITE || f.v[2] == INFINITE;
+}
+
+// point the slot of face across the edge (a, b) at neighbour
+void DelaunayMesh::setNeighbour(int face, int a, int b, int neighbour) {
+	auto &f = faces[face];
+
+	for (int k = 0; k < 3; k++)
+		if (f.v[k] != a && f.v[k] != b) {
+			f.n[k] = neighbour;
+			return;
+		}
+}
+
+// link slot k of face to outer, which takes over the segment mark of their common edge
+void DelaunayMesh::attach(int face, int k, int outer) {
+	auto &f = faces[face];
+	auto &o = faces[outer];
+	auto a = f.v[(k + 1) % 3], b = f.v[(k + 2) % 3];
+
+	f.n[k] = outer;
+	for (int l = 0; l < 3; l++)
+		if (o.v[l] != a && o.v[l] != b) {
+			o.n[l] = face;
+			if (o.fixed & (1 << l))
+				f.fixed |= 1 << k;
+		}
+}
+
+// make the edge opposite slot k of face a segment, on both of its sides
+void DelaunayMesh::fix(int face, int k) {
+	auto &f = faces[face];
+	auto a = f.v[(k + 1) % 3], b = f.v[(k + 2) % 3];
+
+	f.fixed |= 1 << k;
+	auto &o = faces[f.n[k]];
+	for (int l = 0; l < 3; l++)
+		if (o.v[l] != a && o.v[l] != b)
+			o.fixed |= 1 << l;
+}
+
+// the face with the edge a -> b counterclockwise, and in k the slot opposite it; -1 if there is no such edge
+int DelaunayMesh::findEdge(int a, int b, int &k) const {
+	auto first = vertexFace[a];
+	auto face = first;
+
+	do {
+		auto &f = faces[face];
+		auto i = f.v[0] == a ? 0 : (f.v[1] == a ? 1 : 2);
+
+		if (f.v[(i + 1) % 3] == b) {
+			k = (i + 2) % 3;
+			return face;
+		}
+
+		face = f.n[(i + 1) % 3];
+	} while (face != first);
+
+	return -1;
+}
+
+/*
+return TRUE if point breaks the counterclockwise triangle (a, b, c):
+it is strictly inside the circumcircle, or for a ghost triangle it is
+beyond its hull edge or inside that edge
+*/
+bool DelaunayMesh::conflict(int a, int b, int c, const XYZ &point) const {
+	if (c == INFINITE || a == INFINITE || b == INFINITE) {
+		// rotate so that (a, b) is the hull edge, the outside is to its left
+		while (c != INFINITE) {
+			auto t = a;
+			a = b;
+			b = c;
+			c = t;
+		}
+
+		auto &pa = vertices[a];
+		auto &pb = vertices[b];
+		auto side = Triangulate::orientation(pa, pb, point);
+
+		if (side != 0.0)
+			return side > 0.0;
+
+		// on the line: between a and b in x, then y, as on the line both order them alike; no rounding either way
+		auto before = [](const XYZ &u, const XYZ &v) { return u.x < v.x || (u.x == v.x && u.y < v.y); };
+		return (before(pa, point) && before(point, pb)) || (before(pb, point) && before(point, pa));
+	}
+
+	return Triangulate::inCircle(vertices[a], vertices[b], vertices[c], point) > 0.0;
+}
+
+bool DelaunayMesh::conflict(int face, const XYZ &point) const {
+	auto &f = faces[face];
+	return conflict(f.v[0], f.v[1], f.v[2], point);
+}
+
+/*
+Find the face containing point, or a ghost face it is beyond.
+Without a start face the walk starts from the vertex last seen in the grid
+cell of the point, so on reasonably spread points it is only a few steps long
+*/
+int DelaunayMesh::locate(const XYZ &point, int start) {
+	auto face = start == -1 ? lastFace : start;
+
+	// an empty cell falls back on the cells around it
+	if (start == -1 && !grid.empty()) {
+		auto cell = cellOf(point);
+		auto row = cell / gridSize, column = cell % gridSize;
+		auto found = false;
+
+		for (int radius = 0; radius <= 2 && !found; radius++)
+			for (int r = std::max(row - radius, 0); r <= std::min(row + radius, gridSize - 1) && !found; r++)
+				for (int c = std::max(column - radius, 0); c <= std::min(column + radius, gridSize - 1) && !found; c++) {
+					auto v = grid[r * gridSize + c];
+					if (alive(v) && vertexFace[v] >= 0) {
+						face = vertexFace[v];
+						found = true;
+					}
+				}
+	}
+
+	// step off a ghost face into the mesh
+	if (isGhost(face)) {
+		auto &f = faces[face];
+		for (int k = 0; k < 3; k++)
+			if (f.v[k] == INFINITE)
+				face = f.n[k];
+	}
+
+	for (auto steps = finiteFaces; steps >= 0; steps--) {
+		auto &f = faces[face];
+
+		if (isGhost(face))
+			return face;
+
+		// start from a random edge so that the walk can't go round in circles
+		random ^= random << 13;
+		random ^= random >> 17;
+		random ^= random << 5;
+
+		auto first = static_cast<int>(random % 3);
+		auto next = -1;
+
+		for (int i = 0; i < 3; i++) {
+			auto k = (first + i) % 3;
+			auto &a = vertices[f.v[(k + 1) % 3]];
+			auto &b = vertices[f.v[(k + 2) % 3]];
+
+			if (Triangulate::orientation(a, b, point) < 0.0) {
+				next = f.n[k];
+				break;
+			}
+		}
+
+		if (next == -1)
+			return face;
+		face = next;
+	}
+
+	// only triangles that rounding turned over make a walk go round: look at every face
+	for (int i = 0; i < static_cast<int>(faces.size()); i++) {
+		auto &f = faces[i];
+		if (f.v[0] == -1)
+			continue;
+
+		auto in = true;
+		if (isGhost(i))
+			in = conflict(i, point);
+		else
+			for (int k = 0; k < 3 && in; k++)
+				in = Triangulate::orientation(vertices[f.v[(k + 1) % 3]], vertices[f.v[(k + 2) % 3]], point) >= 0.0;
+
+		if (in)
+			return i;
+	}
+
+	return face;
+}
+
+int DelaunayMesh::cellOf(const XYZ &point) const {
+	auto column = static_cast<int>((point.x - gridX) / gridStep);
+	auto row = static_cast<int>((point.y - gridY) / gridStep);
+
+	column = std::min(std::max(column, 0), gridSize - 1);
+	row = std::min(std::max(row, 0), gridSize - 1);
+
+	return row * gridSize + column;
+}
+
+// remember a vertex for its cell; each time the live vertices grow past eight
+// per cell the grid is laid out again over them with two per cell
+void DelaunayMesh::addToGrid(int vertex) {
+	if (liveVertices > 8 * gridSize * gridSize) {
+		double xMin = vertices[vertex].x, xMax = xMin, yMin = vertices[vertex].y, yMax = yMin;
+
+		for (int v = 1; v < static_cast<int>(vertices.size()); v++) {
+			if (vertexFace[v] < 0)
+				continue;
+			xMin = std::min(xMin, vertices[v].x);
+			xMax = std::max(xMax, vertices[v].x);
+			yMin = std::min(yMin, vertices[v].y);
+			yMax = std::max(yMax, vertices[v].y);
+		}
+
+		gridSize = static_cast<int>(std::sqrt(liveVertices / 2.0)) + 1;
+		gridX = xMin;
+		gridY = yMin;
+		gridStep = std::max(xMax - xMin, yMax - yMin) / gridSize;
+		if (gridStep <= 0.0)
+			gridStep = 1.0;
+
+		grid.assign(gridSize * gridSize, -1);
+		for (int v = 1; v < static_cast<int>(vertices.size()); v++)
+			if (vertexFace[v] >= 0)
+				grid[cellOf(vertices[v])] = v;
+	}
+
+	grid[cellOf(vertices[vertex])] = vertex;
+}
+
+// turn the pending vertices into a mesh once three of them are not on a line
+bool DelaunayMesh::build() {
+	if (pending.size() < 3)
+		return false;
+
+	auto a = pending[0];
+	auto b = pending[1];
+	auto c = -1;
+
+	for (auto iter = pending.begin() + 2; iter != pending.end(); ++iter)
+		if (Triangulate::orientation(vertices[a], vertices[b], vertices[*iter]) != 0.0) {
+			c = *iter;
+			break;
+		}
+
+	if (c == -1)
+		return false;
+
+	if (Triangulate::orientation(vertices[a], vertices[b], vertices[c]) < 0.0)
+		std::swap(a, b);
+
+	// one triangle and a ghost on each of its edges
+	int face[4];
+	face[0] = newFace(a, b, c);
+	face[1] = newFace(b, a, INFINITE);
+	face[2] = newFace(c, b, INFINITE);
+	face[3] = newFace(a, c, INFINITE);
+
+	for (int i = 0; i < 4; i++)
+		for (int j = i + 1; j < 4; j++) {
+			int shared[2], count = 0;
+
+			for (int k = 0; k < 3; k++)
+				for (int l = 0; l < 3; l++)
+					if (faces[face[i]].v[k] == faces[face[j]].v[l] && count < 2)
+						shared[count++] = faces[face[i]].v[k];
+
+			setNeighbour(face[i], shared[0], shared[1], face[j]);
+			setNeighbour(face[j], shared[0], shared[1], face[i]);
+		}
+
+	std::vector<int> rest;
+	rest.swap(pending);
+
+	for (auto v : rest)
+		if (v != a && v != b && v != c)
+			insertVertex(v, locate(vertices[v]));
+
+	grid.clear();
+	gridSize = 0;
+	for (auto v : rest)
+		addToGrid(v);
+
+	return true;
+}
+
+int DelaunayMesh::insert(const XYZ &point) {
+	return place(point, -1);
+}
+
+// position of (x, y) along a Hilbert curve filling the 2^16 x 2^16 grid
+static unsigned long long hilbert(unsigned x, unsigned y) {
+	const unsigned side = 1u << 16;
+	unsigned long long d = 0;
+
+	for (unsigned s = side / 2; s > 0; s /= 2) {
+		unsigned rx = (x & s) ? 1 : 0, ry = (y & s) ? 1 : 0;
+		d += static_cast<unsigned long long>(s) * s * ((3 * rx) ^ ry);
+
+		if (ry == 0) {
+			if (rx == 1) {
+				x = side - 1 - x;
+				y = side - 1 - y;
+			}
+			std::swap(x, y);
+		}
+	}
+
+	return d;
+}
+
+/*
+Insert the points in rounds of doubling size picked at random, each round
+in Hilbert curve order (BRIO): random rounds keep the cavities small, and
+the curve order lets each point be found by a short walk from the last one
+*/
+void DelaunayMesh::insert(const std::vector<XYZ> &points, std::vector<int> &result) {
+	auto count = static_cast<int>(points.size());
+	result.assign(count, -1);
+	if (count == 0)
+		return;
+
+	/*
+	The curve runs over the ranks of the coordinates rather than the
+	coordinates, so points spread over many orders of magnitude don't all
+	fall in one cell of it
+	*/
+	std::vector<int> byX(count), byY(count);
+	for (int i = 0; i < count; i++)
+		byX[i] = byY[i] = i;
+
+	std::sort(byX.begin(), byX.end(), [&](int i, int j) { return points[i].x < points[j].x; });
+	std::sort(byY.begin(), byY.end(), [&](int i, int j) { return points[i].y < points[j].y; });
+
+	std::vector<unsigned> x(count), y(count);
+	for (int r = 0; r < count; r++) {
+		x[byX[r]] = static_cast<unsigned>(65536.0 * r / count);
+		y[byY[r]] = static_cast<unsigned>(65536.0 * r / count);
+	}
+
+	std::vector<std::pair<unsigned long long, int>> order(count);
+	for (int i = 0; i < count; i++)
+		order[i] = std::make_pair(hilbert(x[i], y[i]), i);
+
+	for (int i = count - 1; i > 0; i--) {
+		random ^= random << 13;
+		random ^= random >> 17;
+		random ^= random << 5;
+		std::swap(order[i], order[random % (i + 1)]);
+	}
+
+	// the last half is the last round, the quarter before it the one before, and so on
+	for (int end = count; end > 0; ) {
+		auto begin = end > 64 ? end / 2 : 0;
+		std::sort(order.begin() + begin, order.begin() + end);
+		end = begin;
+	}
+
+	for (auto &item : order)
+		result[item.second] = place(points[item.second], finiteFaces == 0 ? -1 : lastFace);
+}
+
+// insert point walking from the face start, or from the grid with -1
+int DelaunayMesh::place(const XYZ &point, int start) {
+	if (finiteFaces == 0) {
+		for (auto v : pending)
+			if (vertices[v].x == point.x && vertices[v].y == point.y)
+				return v;
+
+		auto vertex = newVertex(point);
+		vertexFace[vertex] = PENDING;
+		pending.push_back(vertex);
+		build();
+
+		return vertex;
+	}
+
+	auto face = locate(point, start);
+
+	for (int k = 0; k < 3; k++) {
+		auto v = faces[face].v[k];
+		if (v != INFINITE && vertices[v].x == point.x && vertices[v].y == point.y)
+			return v;
+	}
+
+	// a point right on a segment splits it
+	auto splitA = -1, splitB = -1;
+	if (!isGhost(face))
+		for (int k = 0; k < 3; k++) {
+			auto &f = faces[face];
+			auto a = f.v[(k + 1) % 3], b = f.v[(k + 2) % 3];
+
+			if ((f.fixed & (1 << k)) && Triangulate::orientation(vertices[a], vertices[b], point) == 0.0) {
+				splitA = a;
+				splitB = b;
+			}
+		}
+
+	auto vertex = newVertex(point);
+	insertVertex(vertex, face, splitA, splitB);
+	addToGrid(vertex);
+
+	return vertex;
+}
+
+/*
+Bowyer-Watson step: replace the faces broken by the vertex with a fan around it.
+If (splitA, splitB) is a segment the vertex lies on, it becomes two segments
+*/
+void DelaunayMesh::insertVertex(int vertex, int start, int splitA, int splitB) {
+	findCavity(vertices[vertex], start, splitA, splitB);
+	fillCavity(vertex, splitA, splitB);
+}
+
+/*
+Collect in cavity the faces that point breaks, starting from the face start,
+and in boundary the edges round them as (a, b, face beyond, flags) with
+bit 0 of flags for an exterior cavity face and bit 1 for a segment.
+A segment is never crossed, but for the one being split
+*/
+void DelaunayMesh::findCavity(const XYZ &point, int start, int splitA, int splitB) {
+	stamp += 2;
+	auto inside = stamp, outside = stamp + 1;
+
+	cavity.clear();
+	boundary.clear();
+
+	if (vertexMark.size() < vertices.size())
+		vertexMark.resize(vertices.size(), 0);
+
+	cavity.push_back(start);
+	faceMark[start] = inside;
+	for (int k = 0; k < 3; k++)
+		vertexMark[faces[start].v[k]] = inside;
+
+	for (size_t i = 0; i < cavity.size(); i++) {
+		auto face = cavity[i];
+
+		for (int k = 0; k < 3; k++) {
+			auto neighbour = faces[face].n[k];
+
+			if (faceMark[neighbour] == inside)
+				continue;
+
+			auto a = faces[face].v[(k + 1) % 3];
+			auto b = faces[face].v[(k + 2) % 3];
+
+			if (faces[face].fixed & (1 << k)) {
+				if ((a == splitA && b == splitB) || (a == splitB && b == splitA)) {
+					faceMark[neighbour] = inside;
+					cavity.push_back(neighbour);
+				}
+				else if (faceMark[neighbour] != inside)
+					faceMark[neighbour] = outside;
+				continue;
+			}
+
+			/*
+			Take the neighbour if the point breaks it, or if the new triangle on
+			this edge would come out flat or inverted (which rounding can cause),
+			so that the cavity stays star-shaped around the point
+			*/
+			auto take = faceMark[neighbour] != outside && conflict(neighbour, point);
+			if (!take && a != INFINITE && b != INFINITE)
+				take = Triangulate::orientation(vertices[a], vertices[b], point) <= 0.0;
+
+			/*
+			The corner of the neighbour across the edge has to be new to the cavity:
+			if it is already on the boundary, taking the face would shut a vertex
+			inside. It never is for exact circle tests, which always give a disk
+			*/
+			auto &g = faces[neighbour];
+			for (int l = 0; l < 3 && take; l++)
+				if (g.n[l] == face && vertexMark[g.v[l]] == inside)
+					take = false;
+
+			/*
+			The segments of a face taken end up round the point, which has to see
+			them from the inside; a ghost face behind a segment is never taken
+			*/
+			for (int l = 0; l < 3 && take; l++) {
+				auto c = g.v[(l + 1) % 3], d = g.v[(l + 2) % 3];
+
+				if ((g.fixed & (1 << l)) && c != INFINITE && d != INFINITE
+					&& !((c == splitA && d == splitB) || (c == splitB && d == splitA))
+					&& (isGhost(neighbour) || Triangulate::orientation(vertices[c], vertices[d], point) <= 0.0))
+					take = false;
+			}
+
+			if (take) {
+				faceMark[neighbour] = inside;
+				cavity.push_back(neighbour);
+				for (int l = 0; l < 3; l++)
+					vertexMark[g.v[l]] = inside;
+			}
+			else
+				faceMark[neighbour] = outside;
+		}
+	}
+
+	for (auto face : cavity)
+		for (int k = 0; k < 3; k++) {
+			auto &f = faces[face];
+			if (faceMark[f.n[k]] == inside)
+				continue;
+
+			boundary.push_back(f.v[(k + 1) % 3]);
+			boundary.push_back(f.v[(k + 2) % 3]);
+			boundary.push_back(f.n[k]);
+			boundary.push_back((f.exterior ? 1 : 0) | ((f.fixed >> k) & 1) << 1);
+		}
+}
+
+void DelaunayMesh::fillCavity(int vertex, int splitA, int splitB) {
+	for (auto face : cavity)
+		freeFace(face);
+
+	if (startFace.size() < vertices.size())
+		startFace.resize(vertices.size());
+
+	// fan of new faces, linked to the outside and then to each other
+	newFaces.clear();
+	for (size_t i = 0; i < boundary.size(); i += 4) {
+		auto a = boundary[i], b = boundary[i + 1], outer = boundary[i + 2];
+		auto face = newFace(a, b, vertex);
+
+		faces[face].exterior = (boundary[i + 3] & 1) != 0;
+		attach(face, 2, outer);
+
+		startFace[a] = face;
+		newFaces.push_back(face);
+	}
+
+	for (auto face : newFaces) {
+		auto next = startFace[faces[face].v[1]];
+
+		faces[face].n[0] = next;
+		faces[next].n[1] = face;
+	}
+
+	// the edges (vertex, a) and (vertex, b) are what is left of the split segment
+	if (splitA != -1)
+		for (auto face : newFaces)
+			if (faces[face].v[0] == splitA || faces[face].v[0] == splitB)
+				fix(face, 1);
+}
+
+bool DelaunayMesh::remove(const XYZ &point) {
+	auto vertex = find(point);
+	return vertex != -1 && remove(vertex);
+}
+
+int DelaunayMesh::find(const XYZ &point) {
+	if (finiteFaces == 0) {
+		for (auto v : pending)
+			if (vertices[v].x == point.x && vertices[v].y == point.y)
+				return v;
+		return -1;
+	}
+
+	auto face = locate(point);
+
+	for (int k = 0; k < 3; k++) {
+		auto v = faces[face].v[k];
+		if (v != INFINITE && vertices[v].x == point.x && vertices[v].y == point.y)
+			return v;
+	}
+
+	return -1;
+}
+
+bool DelaunayMesh::remove(int vertex) {
+	if (!alive(vertex))
+		return false;
+
+	if (vertexFace[vertex] == PENDING) {
+		pending.erase(std::find(pending.begin(), pending.end(), vertex));
+		freeVertex(vertex);
+		return true;
+	}
+
+	/*
+	Walk counterclockwise round the vertex: each face (vertex, a, b) gives
+	one edge a -> b of the hole, together with the face beyond that edge
+	*/
+	ring.clear();
+	ringOuter.clear();
+	star.clear();
+
+	auto first = vertexFace[vertex];
+	auto face = first;
+	auto starFinite = 0;
+	auto exterior = false;
+
+	do {
+		auto &f = faces[face];
+		auto i = f.v[0] == vertex ? 0 : (f.v[1] == vertex ? 1 : 2);
+
+		// segments hold on to their ends
+		if (f.fixed & ((1 << (i + 1) % 3) | (1 << (i + 2) % 3)))
+			return false;
+
+		ring.push_back(f.v[(i + 1) % 3]);
+		ringOuter.push_back(f.n[i]);
+		star.push_back(face);
+		if (!isGhost(face)) {
+			starFinite++;
+			exterior = f.exterior;
+		}
+
+		face = f.n[(i + 1) % 3];
+	} while (face != first);
+
+	// without this vertex the rest may lie on a line: go back to pending
+	if (starFinite == finiteFaces) {
+		auto flat = true;
+		XYZ *a = nullptr, *b = nullptr;
+
+		for (auto v : ring) {
+			if (v == INFINITE)
+				continue;
+			if (!a)
+				a = &vertices[v];
+			else if (!b)
+				b = &vertices[v];
+			else if (Triangulate::orientation(*a, *b, vertices[v]) != 0.0)
+				flat = false;
+		}
+
+		if (flat) {
+			reset(vertex);
+			return true;
+		}
+	}
+
+	for (auto f : star)
+		freeFace(f);
+
+	/*
+	Fill the hole by cutting off ears: an ear (a, b, c) is taken when it is
+	a proper triangle and breaks no other vertex of the hole, which makes it
+	a Delaunay triangle of the hole
+	*/
+	while (ring.size() > 3) {
+		auto m = static_cast<int>(ring.size());
+		auto ear = -1, fallback = -1;
+
+		for (int k = 0; k < m && ear == -1; k++) {
+			auto a = ring[k], b = ring[(k + 1) % m], c = ring[(k + 2) % m];
+			auto ghost = a == INFINITE || b == INFINITE || c == INFINITE;
+
+			if (!ghost && Triangulate::orientation(vertices[a], vertices[b], vertices[c]) <= 0.0)
+				continue;
+			if (fallback == -1)
+				fallback = k;
+
+			auto empty = true;
+			for (int l = 3; l < m && empty; l++) {
+				auto w = ring[(k + l) % m];
+				if (w != INFINITE && conflict(a, b, c, vertices[w]))
+					empty = false;
+			}
+
+			if (empty)
+				ear = k;
+		}
+
+		// only rounding gets here; any proper ear will do
+		if (ear == -1)
+			ear = fallback == -1 ? 0 : fallback;
+
+		auto next = (ear + 1) % m;
+		auto after = (ear + 2) % m;
+		auto a = ring[ear], b = ring[next], c = ring[after];
+		auto created = newFace(a, b, c);
+
+		faces[created].exterior = exterior;
+		attach(created, 2, ringOuter[ear]);
+		attach(created, 0, ringOuter[next]);
+
+		ringOuter[ear] = created;
+		ring.erase(ring.begin() + next);
+		ringOuter.erase(ringOuter.begin() + next);
+	}
+
+	auto created = newFace(ring[0], ring[1], ring[2]);
+	faces[created].exterior = exterior;
+	for (int k = 0; k < 3; k++)
+		attach(created, (k + 2) % 3, ringOuter[k]);
+
+	freeVertex(vertex);
+	return true;
+}
+
+// drop every face and put all vertices but one back to pending
+void DelaunayMesh::reset(int except) {
+	changedAll = true;
+	faces.clear();
+	freeFaces.clear();
+	faceMark.clear();
+	finiteFaces = 0;
+	lastFace = -1;
+	pending.clear();
+
+	for (int v = 1; v < static_cast<int>(vertices.size()); v++) {
+		if (vertexFace[v] == FREE)
+			continue;
+
+		if (v == except) {
+			freeVertex(v);
+			continue;
+		}
+
+		vertexFace[v] = PENDING;
+		pending.push_back(v);
+	}
+
+	build();
+}
+
+void DelaunayMesh::triangles(std::vector<Triangle> &result) const {
+	result.clear();
+
+	Triangle item;
+	for (int face = 0; face < faceCapacity(); face++)
+		if (triangle(face, item))
+			result.push_back(item);
+}
+
+bool DelaunayMesh::check() const {
+	long errors = 0;
+
+	for (int face = 0; face < faceCapacity(); face++) {
+		auto &f = faces[face];
+		if (f.v[0] == -1)
+			continue;
+
+		if (!isGhost(face) && Triangulate::orientation(vertices[f.v[0]], vertices[f.v[1]], vertices[f.v[2]]) <= 0.0) {
+			std::cout << "mesh: face " << face << " is flat or turned clockwise" << std::endl;
+			errors++;
+		}
+
+		for (int k = 0; k < 3; k++) {
+			auto a = f.v[(k + 1) % 3], b = f.v[(k + 2) % 3];
+			auto n = f.n[k];
+			auto back = false;
+
+			if (n >= 0 && n < faceCapacity() && faces[n].v[0] != -1)
+				for (int l = 0; l < 3; l++)
+					back = back || (faces[n].n[l] == face && faces[n].v[(l + 1) % 3] == b && faces[n].v[(l + 2) % 3] == a);
+
+			if (!back) {
+				std::cout << "mesh: face " << face << " and its neighbour across " << a << "-" << b << " don't agree" << std::endl;
+				errors++;
+			}
+		}
+	}
+
+	for (int v = 1; v < vertexCapacity(); v++) {
+		auto face = vertexFace[v];
+		if (face < 0)
+			continue;
+
+		auto &f = faces[face];
+		if (f.v[0] != v && f.v[1] != v && f.v[2] != v) {
+			std::cout << "mesh: vertex " << v << " points at face " << face << ", which isn't round it" << std::endl;
+			errors++;
+		}
+	}
+
+	if (errors)
+		std::cout << "mesh: " << errors << " problems" << std::endl;
+	return errors == 0;
+}
+
+bool DelaunayMesh::triangle(int face, Triangle &result) const {
+	auto &f = faces[face];
+	if (f.v[0] == -1 || f.exterior || f.v[0] == INFINITE || f.v[1] == INFINITE || f.v[2] == INFINITE)
+		return false;
+
+	result.p1 = f.v[0];
+	result.p2 = f.v[2];
+	result.p3 = f.v[1];
+	return true;
+}
+
+void DelaunayMesh::trackChanges(bool on) {
+	tracking = on;
+	changedAll = false;
+	changedVertexList.clear();
+	changedFaceList.clear();
+}
+
+bool DelaunayMesh::takeChanges(std::vector<int> &changedVertices, std::vector<int> &changedFaces) {
+	auto listed = !changedAll;
+
+	// a slot given and taken back in one update is listed twice
+	std::sort(changedVertexList.begin(), changedVertexList.end());
+	changedVertexList.erase(std::unique(changedVertexList.begin(), changedVertexList.end()), changedVertexList.end());
+	std::sort(changedFaceList.begin(), changedFaceList.end());
+	changedFaceList.erase(std::unique(changedFaceList.begin(), changedFaceList.end()), changedFaceList.end());
+
+	changedVertices.swap(changedVertexList);
+	changedFaces.swap(changedFaceList);
+	changedVertexList.clear();
+	changedFaceList.clear();
+	changedAll = false;
+
+	return listed;
+}
+
+bool DelaunayMesh::insertSegment(int a, int b) {
+	if (!alive(a) || !alive(b) || vertexFace[a] < 0 || vertexFace[b] < 0)
+		return false;
+
+	while (a != b) {
+		int k;
+		auto face = findEdge(a, b, k);
+
+		if (face != -1) {
+			fix(face, k);
+			return true;
+		}
+
+		/*
+		Turn round a for the triangle the way to b leaves through, or for a
+		neighbour lying on the way, which takes the segment over from there
+		*/
+		auto &pa = vertices[a];
+		auto &pb = vertices[b];
+		auto first = vertexFace[a];
+		auto start = -1, on = -1;
+
+		face = first;
+		do {
+			auto &f = faces[face];
+			auto i = f.v[0] == a ? 0 : (f.v[1] == a ? 1 : 2);
+			auto c = f.v[(i + 1) % 3], d = f.v[(i + 2) % 3];
+
+			if (c != INFINITE && d != INFINITE) {
+				auto &pc = vertices[c];
+				auto side = Triangulate::orientation(pa, pc, pb);
+
+				if (side == 0.0 && (pc.x - pa.x) * (pb.x - pa.x) + (pc.y - pa.y) * (pb.y - pa.y) > 0.0) {
+					on = c;
+					break;
+				}
+				if (side > 0.0 && Triangulate::orientation(pa, pb, vertices[d]) > 0.0) {
+					start = face;
+					break;
+				}
+			}
+
+			face = f.n[(i + 1) % 3];
+		} while (face != first);
+
+		if (on != -1) {
+			face = findEdge(a, on, k);
+			fix(face, k);
+			a = on;
+			continue;
+		}
+
+		if (start == -1)
+			return false;
+
+		/*
+		Walk the triangles the way crosses up to b or a vertex on the way,
+		keeping the vertices met on its left and on its right in order
+		*/
+		left.clear();
+		right.clear();
+		cavity.clear();
+
+		auto i = faces[start].v[0] == a ? 0 : (faces[start].v[1] == a ? 1 : 2);
+		auto r = faces[start].v[(i + 1) % 3], l = faces[start].v[(i + 2) % 3];
+		auto exit = i;
+		auto end = -1;
+
+		right.push_back(r);
+		left.push_back(l);
+		face = start;
+
+		while (end == -1) {
+			if (faces[face].fixed & (1 << exit)) {
+				std::cout << "Segment crosses another segment" << std::endl;
+				return false;
+			}
+
+			cavity.push_back(face);
+			face = faces[face].n[exit];
+
+			auto &f = faces[face];
+			auto j = 0;
+			while (f.v[j] == r || f.v[j] == l)
+				j++;
+
+			auto w = f.v[j];
+			if (w == INFINITE)
+				return false;
+
+			auto side = Triangulate::orientation(pa, pb, vertices[w]);
+
+			if (w == b || side == 0.0) {
+				cavity.push_back(face);
+				end = w;
+			}
+			else if (side > 0.0) {
+				left.push_back(w);
+				exit = f.v[0] == l ? 0 : (f.v[1] == l ? 1 : 2);
+				l = w;
+			}
+			else {
+				right.push_back(w);
+				exit = f.v[0] == r ? 0 : (f.v[1] == r ? 1 : 2);
+				r = w;
+			}
+		}
+
+		// the outline of the crossed faces, kept to link the new ones to
+		stamp += 2;
+		for (auto f : cavity)
+			faceMark[f] = stamp;
+
+		boundary.clear();
+		for (auto f : cavity)
+			for (int k = 0; k < 3; k++)
+				if (faceMark[faces[f].n[k]] != stamp) {
+					boundary.push_back(faces[f].v[(k + 1) % 3]);
+					boundary.push_back(faces[f].v[(k + 2) % 3]);
+					boundary.push_back(faces[f].n[k]);
+				}
+
+		auto exterior = faces[cavity[0]].exterior;
+		for (auto f : cavity)
+			freeFace(f);
+
+		newFaces.clear();
+		fillPolygon(a, end, left, exterior);
+		std::reverse(right.begin(), right.end());
+		fillPolygon(end, a, right, exterior);
+
+		// every new edge is either shared by two new faces or on the outline
+		auto key = [](int u, int v) {
+			return static_cast<unsigned long long>(std::min(u, v)) << 32 | static_cast<unsigned>(std::max(u, v));
+		};
+
+		edgeSlots.clear();
+		for (auto f : newFaces)
+			for (int k = 0; k < 3; k++)
+				edgeSlots.push_back(std::make_pair(key(faces[f].v[(k + 1) % 3], faces[f].v[(k + 2) % 3]), 3 * f + k));
+		std::sort(edgeSlots.begin(), edgeSlots.end());
+
+		for (size_t e = 0; e + 1 < edgeSlots.size(); e++)
+			if (edgeSlots[e].first == edgeSlots[e + 1].first) {
+				auto one = edgeSlots[e].second, other = edgeSlots[e + 1].second;
+				faces[one / 3].n[one % 3] = other / 3;
+				faces[other / 3].n[other % 3] = one / 3;
+				e++;
+			}
+
+		for (size_t e = 0; e < boundary.size(); e += 3) {
+			auto slot = std::lower_bound(edgeSlots.begin(), edgeSlots.end(),
+				std::make_pair(key(boundary[e], boundary[e + 1]), -1))->second;
+			attach(slot / 3, slot % 3, boundary[e + 2]);
+		}
+
+		face = findEdge(a, end, k);
+		fix(face, k);
+		a = end;
+	}
+
+	return true;
+}
+
+/*
+Triangulate the hole on the left of a -> b whose outline runs from a through
+chain to b. The apex of each edge is the chain vertex whose circle with the
+edge holds no other one, which gives the constrained Delaunay triangles
+*/
+void DelaunayMesh::fillPolygon(int a, int b, const std::vector<int> &chain, bool exterior) {
+	spans.clear();
+	spans.push_back(a);
+	spans.push_back(b);
+	spans.push_back(0);
+	spans.push_back(static_cast<int>(chain.size()));
+
+	while (!spans.empty()) {
+		auto high = spans.back(); spans.pop_back();
+		auto low = spans.back(); spans.pop_back();
+		auto to = spans.back(); spans.pop_back();
+		auto from = spans.back(); spans.pop_back();
+
+		if (low >= high)
+			continue;
+
+		auto c = low;
+		for (int i = low + 1; i < high; i++)
+			if (Triangulate::inCircle(vertices[from], vertices[to], vertices[chain[c]], vertices[chain[i]]) > 0.0)
+				c = i;
+
+		auto face = newFace(from, to, chain[c]);
+		faces[face].exterior = exterior;
+		newFaces.push_back(face);
+
+		spans.push_back(from);
+		spans.push_back(chain[c]);
+		spans.push_back(low);
+		spans.push_back(c);
+
+		spans.push_back(chain[c]);
+		spans.push_back(to);
+		spans.push_back(c + 1);
+		spans.push_back(high);
+	}
+}
+
+// flood the faces from infinity without crossing segments; what is reached is exterior
+void DelaunayMesh::carve() {
+	changedAll = true;
+	stamp += 2;
+	cavity.clear();
+
+	for (size_t face = 0; face < faces.size(); face++) {
+		if (faces[face].v[0] == -1)
+			continue;
+
+		faces[face].exterior = false;
+		if (isGhost(static_cast<int>(face))) {
+			faceMark[face] = stamp;
+			cavity.push_back(static_cast<int>(face));
+		}
+	}
+
+	for (size_t i = 0; i < cavity.size(); i++) {
+		auto &f = faces[cavity[i]];
+		f.exterior = true;
+
+		for (int k = 0; k < 3; k++)
+			if (!(f.fixed & (1 << k)) && faceMark[f.n[k]] != stamp) {
+				faceMark[f.n[k]] = stamp;
+				cavity.push_back(f.n[k]);
+			}
+	}
+}
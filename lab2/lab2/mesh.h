@@ -0,0 +1,162 @@
+#pragma once
+#include "triangulate.h"
+
+/*
+Delaunay triangulation kept up to date while points come and go.
+A point is inserted by Bowyer-Watson on the cavity of triangles whose
+circumcircle it breaks, and removed by retriangulating the hole it leaves,
+so an update only touches triangles next to the point.
+The convex hull is closed by "ghost" triangles sharing one vertex at
+infinity, so there is no supertriangle and the caller's points are never touched.
+
+Edges between vertices can be made constrained (segments): insertion then
+keeps them, and refine() adds points until the triangles are well shaped.
+*/
+class DelaunayMesh {
+public:
+	static const int INFINITE = 0; // the vertex at infinity, real vertices start at 1
+
+	DelaunayMesh();
+
+	// add a point and return its vertex, or the vertex that is already there
+	int insert(const XYZ &point);
+
+	// add many points at once, in an order that is quick to insert; result[i] is the vertex of points[i]
+	void insert(const std::vector<XYZ> &points, std::vector<int> &result);
+
+	// remove a vertex, FALSE if there is no such vertex or it ends a segment
+	bool remove(int vertex);
+	bool remove(const XYZ &point);
+
+	// the vertex at point, -1 if there is none
+	int find(const XYZ &point);
+
+	bool alive(int vertex) const { return vertex > 0 && vertex < static_cast<int>(vertices.size()) && vertexFace[vertex] != FREE; }
+	const XYZ &vertex(int vertex) const { return vertices[vertex]; }
+
+	int vertexNumber() const { return liveVertices; }
+	int vertexCapacity() const { return static_cast<int>(vertices.size()); }
+	int triangleNumber() const { return finiteFaces; }
+
+	// the finite triangles in clockwise order, like Triangulate gives them; indices are vertices
+	// triangles carved out as exterior are left out
+	void triangles(std::vector<Triangle> &result) const;
+
+	/*
+	The same triangles one face slot at a time: a slot keeps its triangle
+	until an update takes it, so a renderer can send only the slots that changed.
+	FALSE for a slot without a triangle
+	*/
+	int faceCapacity() const { return static_cast<int>(faces.size()); }
+	bool triangle(int face, Triangle &result) const;
+
+	/*
+	With tracking on, the vertices and face slots that updates give or take
+	are recorded, and takeChanges() hands over those since the last call,
+	each once. FALSE instead when the mesh was rebuilt or carved, which
+	changes every slot, so the caller has to read them all again
+	*/
+	void trackChanges(bool on);
+	bool takeChanges(std::vector<int> &changedVertices, std::vector<int> &changedFaces);
+
+	/*
+	Check the links of the mesh: every finite face turned counterclockwise,
+	by the exact test, each neighbour linked back across the same edge and
+	each vertex pointing at a face round it.
+	Problems are reported to stdout
+	*/
+	bool check() const;
+
+	/*
+	Make the edge between vertices a and b a segment: the triangles it
+	crosses are removed and the two holes on either side are retriangulated.
+	A vertex lying on the way splits it in two segments.
+	Return FALSE if a or b is not in the mesh or the way crosses another segment
+	*/
+	bool insertSegment(int a, int b);
+
+	// mark the triangles that segments don't enclose as exterior
+	void carve();
+
+	/*
+	Ruppert's refinement: split segments whose diametral circle holds a vertex,
+	and put a vertex at the circumcentre of every triangle with an angle below
+	minAngle degrees or an area above maxArea (0 for no limit), unless that
+	vertex would encroach a segment, which is then split instead.
+	The convex hull is made of segments first. Exterior triangles are left alone.
+	Angles up to about 30 degrees finish in practice, but small angles between
+	input segments can't be fixed, so at most pointLimit vertices are added.
+	Return the number of vertices added
+	*/
+	int refine(double minAngle, double maxArea, int pointLimit);
+
+private:
+	static const int FREE = -2; // vertexFace of an unused vertex
+	static const int PENDING = -1; // vertexFace of a vertex waiting for a proper mesh
+
+	/*
+	counterclockwise triangle, n[i] is the neighbour across the edge opposite v[i];
+	bit i of fixed is set when that edge is a segment
+	*/
+	struct Face {
+		int v[3];
+		int n[3];
+		unsigned char fixed;
+		bool exterior;
+	};
+
+	std::vector<XYZ> vertices;
+	std::vector<int> vertexFace; // a face around each vertex
+	std::vector<int> freeVertices;
+	int liveVertices;
+
+	std::vector<Face> faces;
+	std::vector<int> freeFaces;
+	int finiteFaces;
+	int lastFace;
+
+	// until three points are not on a line there is no mesh, only pending vertices
+	std::vector<int> pending;
+
+	// a recent vertex in each cell of a square grid, to start point location from
+	std::vector<int> grid;
+	int gridSize;
+	double gridX, gridY, gridStep;
+
+	// what changed since takeChanges(), while tracking
+	bool tracking, changedAll;
+	std::vector<int> changedVertexList, changedFaceList;
+
+	// scratch buffers reused by every update
+	std::vector<unsigned> faceMark, vertexMark;
+	unsigned stamp;
+	std::vector<int> cavity, boundary, newFaces, startFace;
+	std::vector<int> ring, ringOuter, star;
+	std::vector<int> left, right, spans;
+	std::vector<std::pair<unsigned long long, int>> edgeSlots;
+	unsigned random;
+
+	int newVertex(const XYZ &point);
+	void freeVertex(int vertex);
+	int newFace(int a, int b, int c);
+	void freeFace(int face);
+	bool isGhost(int face) const;
+	void setNeighbour(int face, int a, int b, int neighbour);
+	void attach(int face, int k, int outer);
+	void fix(int face, int k);
+	int findEdge(int a, int b, int &k) const;
+
+	bool conflict(int a, int b, int c, const XYZ &point) const;
+	bool conflict(int face, const XYZ &point) const;
+	int locate(const XYZ &point, int start = -1);
+	int place(const XYZ &point, int start);
+	int cellOf(const XYZ &point) const;
+	void addToGrid(int vertex);
+
+	bool build();
+	void insertVertex(int vertex, int start, int splitA = -1, int splitB = -1);
+	void findCavity(const XYZ &point, int start, int splitA, int splitB);
+	void fillCavity(int vertex, int splitA, int splitB);
+	void fillPolygon(int a, int b, const std::vector<int> &chain, bool exterior);
+	void reset(int except);
+};
@@ -0,0 +1,461 @@
+#include "meshbuffer.h"
+#include <cstring>
+#include <algorithm>
+
+// two dirty ranges closer than this many words are sent as one
+static const size_t RANGE_GAP = 64;
+
+// an empty slot of the edge table
+static const unsigned long long NO_EDGE = ~0ull;
+
+StreamBuffer::StreamBuffer(GLenum target) : uploadedBytes(0), uploadCalls(0), target(target), buffer(0), capacity(0), size(0),
+	mapped(nullptr), regions(1), region(0), fresh(false) {
+
+	storage = GLEW_ARB_buffer_storage != 0;
+	for (auto &sync : fences)
+		sync = nullptr;
+}
+
+StreamBuffer::~StreamBuffer() {
+	for (auto &sync : fences)
+		if (sync)
+			glDeleteSync(sync);
+
+	if (mapped) {
+		glBindBuffer(target, buffer);
+		glUnmapBuffer(target);
+		glBindBuffer(target, 0);
+	}
+
+	glDeleteBuffers(1, &buffer);
+}
+
+// a new buffer with room for words in each region, holding nothing yet
+void StreamBuffer::allocate(size_t words) {
+	// buffer storage is immutable, so growing it means a new buffer
+	if (buffer) {
+		if (mapped) {
+			glBindBuffer(target, buffer);
+			glUnmapBuffer(target);
+			mapped = nullptr;
+		}
+		glDeleteBuffers(1, &buffer);
+	}
+
+	// the old buffer's draws keep it alive in the driver, so its fences are no use
+	for (auto &sync : fences)
+		if (sync) {
+			glDeleteSync(sync);
+			sync = nullptr;
+		}
+
+	capacity = words;
+	regions = storage ? REGIONS : 1;
+	region = 0;
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(target, buffer);
+
+	if (storage) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+		glBufferStorage(target, regions * capacity * sizeof(GLuint), nullptr, flags);
+		mapped = static_cast<GLuint*>(glMapBufferRange(target, 0, regions * capacity * sizeof(GLuint), flags));
+	}
+	else
+		glBufferData(target, capacity * sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
+
+	glBindBuffer(target, 0);
+}
+
+// send number words from data to the current region at word first; the buffer is bound
+void StreamBuffer::write(size_t first, size_t number, const GLuint *data) {
+	if (mapped)
+		memcpy(mapped + region * capacity + first, data, number * sizeof(GLuint));
+	else
+		glBufferSubData(target, first * sizeof(GLuint), number * sizeof(GLuint), data);
+
+	uploadedBytes += number * sizeof(GLuint);
+	uploadCalls++;
+}
+
+/*
+Block until the GPU is past the last draw from region r. The wait is
+given a second at a time, and a GPU that is only slow gets more of them;
+if waiting fails altogether glFinish() is the one safe way left, as the
+region can't be written while a draw may still read it
+*/
+void StreamBuffer::wait(int r) {
+	if (!fences[r])
+		return;
+
+	for (;;) {
+		auto status = glClientWaitSync(fences[r], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+
+		if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+			break;
+		if (status == GL_WAIT_FAILED) {
+			glFinish();
+			break;
+		}
+	}
+
+	glDeleteSync(fences[r]);
+	fences[r] = nullptr;
+}
+
+void StreamBuffer::invalidate(size_t first, size_t number) {
+	if (number == 0)
+		return;
+
+	fresh = true;
+
+	// every region lacks the change until it is next written
+	for (int r = 0; r < regions; r++) {
+		auto &ranges = pending[r];
+
+		// runs of neighbouring words come one at a time, so extend the last range where it can
+		if (!ranges.empty() && first >= ranges.back().first && first <= ranges.back().second + RANGE_GAP)
+			ranges.back().second = std::max(ranges.back().second, first + number);
+		else
+			ranges.push_back(std::make_pair(first, first + number));
+	}
+}
+
+bool StreamBuffer::update(const void *data, size_t words) {
+	auto source = static_cast<const GLuint*>(data);
+	auto replaced = false;
+
+	if (words > capacity || !buffer) {
+		allocate(std::max<size_t>(words + words / 2, 16));
+		replaced = true;
+		for (auto &ranges : pending)
+			ranges.clear();
+		invalidate(0, words);
+	}
+	else if (words > size)
+		invalidate(size, words - size);
+	size = words;
+
+	// with nothing new the region the last draw used is still whole
+	if (!fresh)
+		return replaced;
+	fresh = false;
+
+	// the next region in the ring, which the GPU is the least likely to be still reading
+	auto next = (region + 1) % regions;
+	auto &ranges = pending[next];
+
+	// in order, merged where they overlap or are close, and within the words held
+	std::sort(ranges.begin(), ranges.end());
+
+	size_t merged = 0, dirty = 0;
+	for (auto &range : ranges) {
+		range.second = std::min(range.second, words);
+		if (range.first >= range.second)
+			continue;
+
+		if (merged > 0 && range.first <= ranges[merged - 1].second + RANGE_GAP)
+			ranges[merged - 1].second = std::max(ranges[merged - 1].second, range.second);
+		else
+			ranges[merged++] = range;
+	}
+	ranges.resize(merged);
+
+	for (auto &range : ranges)
+		dirty += range.second - range.first;
+
+	glBindBuffer(target, buffer);
+
+	if (mapped)
+		wait(next);
+	else if (dirty > words / 2) {
+		// a fresh store for mostly new contents, so the driver doesn't wait for the old one
+		glBufferData(target, capacity * sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
+		ranges.assign(1, std::make_pair(static_cast<size_t>(0), words));
+	}
+
+	region = next;
+	for (auto &range : ranges)
+		write(range.first, range.second - range.first, source + range.first);
+
+	glBindBuffer(target, 0);
+
+	ranges.clear();
+	return replaced;
+}
+
+void StreamBuffer::fence() {
+	if (!mapped)
+		return;
+
+	if (fences[region])
+		glDeleteSync(fences[region]);
+	fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+MeshBuffer::MeshBuffer(bool quantized) : quantized(quantized), fixedBounds(false), xMin(0.0), yMin(0.0), size(1.0),
+	positions(GL_ARRAY_BUFFER), edges(GL_ELEMENT_ARRAY_BUFFER), edgeIndexNumber(0) {
+
+	glGenVertexArrays(1, &VAO);
+}
+
+MeshBuffer::~MeshBuffer() {
+	glDeleteVertexArrays(1, &VAO);
+}
+
+void MeshBuffer::setBounds(double x, double y, double side) {
+	xMin = x;
+	yMin = y;
+	size = side > 0.0 ? side : 1.0;
+	fixedBounds = true;
+}
+
+void MeshBuffer::updatePoints(const std::vector<XYZ> &points) {
+	if (!fixedBounds && !points.empty()) {
+		double xMax = points[0].x, yMax = points[0].y;
+
+		xMin = xMax;
+		yMin = yMax;
+		for (auto &point : points) {
+			xMin = std::min(xMin, point.x);
+			yMin = std::min(yMin, point.y);
+			xMax = std::max(xMax, point.x);
+			yMax = std::max(yMax, point.y);
+		}
+
+		size = std::max(xMax - xMin, yMax - yMin);
+		if (size <= 0.0)
+			size = 1.0;
+	}
+
+	// one word per point quantized, two as floats
+	packed.resize(quantized ? points.size() : 2 * points.size());
+
+	for (size_t i = 0; i < points.size(); i++)
+		pack(points[i], i);
+	positions.invalidate(0, packed.size());
+
+	sendPoints();
+}
+
+void MeshBuffer::updatePoints(const std::vector<XYZ> &points, const std::vector<int> &changed) {
+	auto words = quantized ? 1 : 2;
+
+	packed.resize(words * points.size());
+
+	for (auto i : changed) {
+		pack(points[i], i);
+		positions.invalidate(words * i, words);
+	}
+
+	sendPoints();
+}
+
+void MeshBuffer::pack(const XYZ &point, size_t index) {
+	if (quantized) {
+		auto x = std::min(std::max((point.x - xMin) / size, 0.0), 1.0);
+		auto y = std::min(std::max((point.y - yMin) / size, 0.0), 1.0);
+
+		packed[index] = static_cast<GLuint>(x * 65535.0 + 0.5) | static_cast<GLuint>(y * 65535.0 + 0.5) << 16;
+	}
+	else {
+		auto x = static_cast<GLfloat>(point.x);
+		auto y = static_cast<GLfloat>(point.y);
+
+		memcpy(&packed[2 * index], &x, sizeof(GLfloat));
+		memcpy(&packed[2 * index + 1], &y, sizeof(GLfloat));
+	}
+}
+
+// the points go in the next region of the ring, and the attribute is pointed there at the draw
+void MeshBuffer::sendPoints() {
+	positions.update(packed.data(), packed.size());
+}
+
+// the attribute at the region of the points the last update wrote; the VAO is bound
+void MeshBuffer::bindPoints() {
+	auto offset = reinterpret_cast<GLvoid*>(positions.offset());
+
+	glBindBuffer(GL_ARRAY_BUFFER, positions.id());
+	if (quantized)
+		glVertexAttribPointer(0, 2, GL_UNSIGNED_SHORT, GL_TRUE, 2 * sizeof(GLushort), offset);
+	else
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), offset);
+	glEnableVertexAttribArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+static unsigned long long edgeKey(GLuint a, GLuint b) {
+	return static_cast<unsigned long long>(a) << 32 | b;
+}
+
+static GLuint corner(const Triangle &triangle, int k) {
+	return static_cast<GLuint>(k == 0 ? triangle.p1 : (k == 1 ? triangle.p2 : triangle.p3));
+}
+
+// where a key's probe starts in a table of mask + 1 entries
+static size_t edgeHome(unsigned long long key, size_t mask) {
+	return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 20) & mask;
+}
+
+// the slot of the triangle with the directed edge a to b, -1 if there is none
+int MeshBuffer::findEdge(GLuint a, GLuint b) const {
+	auto key = edgeKey(a, b);
+	auto mask = table.size() - 1;
+
+	for (auto s = edgeHome(key, mask); table[s].first != NO_EDGE; s = (s + 1) & mask)
+		if (table[s].first == key)
+			return table[s].second;
+	return -1;
+}
+
+// the edges of held[slot] into the table, and the slots across them into touched
+void MeshBuffer::addEdges(int slot) {
+	auto mask = table.size() - 1;
+
+	for (int k = 0; k < 3; k++) {
+		auto a = corner(held[slot], k), b = corner(held[slot], (k + 1) % 3);
+		if (a == b)
+			continue;
+
+		auto key = edgeKey(a, b);
+		auto s = edgeHome(key, mask);
+		while (table[s].first != NO_EDGE && table[s].first != key)
+			s = (s + 1) & mask;
+		table[s] = std::make_pair(key, slot);
+
+		auto twin = findEdge(b, a);
+		if (twin != -1)
+			touched.push_back(twin);
+	}
+}
+
+// the edges of held[slot] out of the table, and the slots across them into touched
+void MeshBuffer::removeEdges(int slot) {
+	auto mask = table.size() - 1;
+
+	for (int k = 0; k < 3; k++) {
+		auto a = corner(held[slot], k), b = corner(held[slot], (k + 1) % 3);
+		if (a == b)
+			continue;
+
+		auto key = edgeKey(a, b);
+		auto s = edgeHome(key, mask);
+		while (table[s].first != NO_EDGE && table[s].first != key)
+			s = (s + 1) & mask;
+
+		// another slot may have taken the edge over in the same update
+		if (table[s].first != key || table[s].second != slot)
+			continue;
+
+		// close the gap: move back each entry after it whose probe passed through it
+		for (auto next = (s + 1) & mask; table[next].first != NO_EDGE; next = (next + 1) & mask)
+			if (((next - edgeHome(table[next].first, mask)) & mask) >= ((next - s) & mask)) {
+				table[s] = table[next];
+				s = next;
+			}
+		table[s].first = NO_EDGE;
+
+		auto twin = findEdge(b, a);
+		if (twin != -1)
+			touched.push_back(twin);
+	}
+}
+
+/*
+The three edges of a slot; an inner edge is left to its twin with the
+lower first index and is written as a point, which draws nothing
+*/
+void MeshBuffer::writeLines(int slot) {
+	for (int k = 0; k < 3; k++) {
+		auto a = corner(held[slot], k), b = corner(held[slot], (k + 1) % 3);
+		auto draw = a < b || (a != b && findEdge(b, a) == -1);
+
+		lines[6 * slot + 2 * k] = a;
+		lines[6 * slot + 2 * k + 1] = draw ? b : a;
+	}
+}
+
+// a table for every directed edge of held, twice the size of a power of two
+void MeshBuffer::rehash() {
+	size_t entries = 16;
+	while (entries < 6 * held.size())
+		entries *= 2;
+	table.assign(entries, std::make_pair(NO_EDGE, -1));
+
+	for (size_t slot = 0; slot < held.size(); slot++)
+		addEdges(static_cast<int>(slot));
+	touched.clear();
+}
+
+void MeshBuffer::updateEdges(const std::vector<Triangle> &triangles) {
+	held = triangles;
+	rehash();
+
+	lines.resize(6 * held.size());
+	for (size_t slot = 0; slot < held.size(); slot++)
+		writeLines(static_cast<int>(slot));
+
+	edges.invalidate(0, lines.size());
+	edgeIndexNumber = static_cast<GLsizei>(lines.size());
+	edges.update(lines.data(), lines.size());
+}
+
+void MeshBuffer::updateEdges(const std::vector<Triangle> &triangles, const std::vector<int> &changed) {
+	// new slots start empty, and they are all in changed
+	if (triangles.size() > held.size()) {
+		Triangle empty;
+		empty.p1 = empty.p2 = empty.p3 = 0;
+
+		held.resize(triangles.size(), empty);
+		lines.resize(6 * held.size(), 0);
+		if (table.size() < 6 * held.size())
+			rehash();
+	}
+
+	// all the old edges go before the new ones come, so a twin is looked up in the final table
+	touched.clear();
+	for (auto slot : changed)
+		removeEdges(slot);
+	for (auto slot : changed) {
+		held[slot] = triangles[slot];
+		addEdges(slot);
+		touched.push_back(slot);
+	}
+
+	for (auto slot : touched) {
+		writeLines(slot);
+		edges.invalidate(6 * slot, 6);
+	}
+
+	edgeIndexNumber = static_cast<GLsizei>(lines.size());
+	edges.update(lines.data(), lines.size());
+}
+
+void MeshBuffer::transform(GLfloat result[4]) const {
+	if (quantized) {
+		result[0] = result[1] = 2.0f;
+		result[2] = result[3] = -1.0f;
+	}
+	else {
+		result[0] = result[1] = static_cast<GLfloat>(2.0 / size);
+		result[2] = static_cast<GLfloat>(-1.0 - 2.0 * xMin / size);
+		result[3] = static_cast<GLfloat>(-1.0 - 2.0 * yMin / size);
+	}
+}
+
+void MeshBuffer::drawEdges() {
+	if (edgeIndexNumber == 0)
+		return;
+
+	glBindVertexArray(VAO);
+	bindPoints();
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, edges.id());
+	glDrawElements(GL_LINES, edgeIndexNumber, GL_UNSIGNED_INT, reinterpret_cast<GLvoid*>(edges.offset()));
+	glBindVertexArray(0);
+
+	// neither region is written again until the GPU is past this draw
+	positions.fence();
+	edges.fence();
+}
@@ -0,0 +1,150 @@
+#pragma once
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+#ifndef GLEW_STATIC
+#define GLEW_STATIC
+#endif
+#include <GL/glew.h>
+
+#include "triangulate.h"
+
+/*
+One buffer object that is created once and then only sent the ranges of
+its contents that the caller marked as changed with invalidate().
+With ARB_buffer_storage the buffer is mapped once, persistently, as a ring
+of REGIONS copies: an update writes the next region while the GPU may
+still draw from the others, waiting only on that region's own fence, and
+brings it up to date with every range it missed since it was last
+written. Without it the ranges go through glBufferSubData, and an update
+that touches most of the buffer orphans it instead of waiting on the GPU
+*/
+class StreamBuffer {
+public:
+	static const int REGIONS = 3;
+
+	StreamBuffer(GLenum target);
+	~StreamBuffer();
+
+	// words [first, first + number) changed, for the next update() to send
+	void invalidate(size_t first, size_t number);
+
+	/*
+	hold words 32 bit words from data, sending the ranges invalidated since
+	the last update, and every word when the buffer grew or was replaced;
+	TRUE if the buffer object was replaced to make room
+	*/
+	bool update(const void *data, size_t words);
+
+	// after a draw from offset(): the region isn't written again until the GPU is past it
+	void fence();
+
+	GLuint id() const { return buffer; }
+	size_t offset() const { return region * capacity * sizeof(GLuint); } // bytes to the region to draw from
+	bool persistent() const { return mapped != nullptr; }
+	size_t bytes() const { return size * sizeof(GLuint); }
+
+	size_t uploadedBytes;
+	int uploadCalls;
+
+private:
+	GLenum target;
+	GLuint buffer;
+	size_t capacity, size; // words, of one region
+	bool storage;
+	GLuint *mapped;
+
+	int regions, region; // region is the one last written, which draws read
+	bool fresh; // anything invalidated since the last update
+	GLsync fences[REGIONS];
+	std::vector<std::pair<size_t, size_t>> pending[REGIONS]; // [begin, end) words each region lacks
+
+	void allocate(size_t words);
+	void write(size_t first, size_t number, const GLuint *data);
+	void wait(int r);
+
+	StreamBuffer(const StreamBuffer &) = delete;
+	StreamBuffer &operator=(const StreamBuffer &) = delete;
+};
+
+/*
+A triangulation on the GPU in indexed form: every point once, in 2 floats
+or, quantized, in 2 normalized 16 bit integers over the bounds, and the
+edges as an index buffer for drawing the wireframe with GL_LINES. The
+vertex shader puts the points in clip space with the scale and offset
+from transform().
+Needs a current GL context for its whole life
+*/
+class MeshBuffer {
+public:
+	MeshBuffer(bool quantized = false);
+	~MeshBuffer();
+
+	// the square drawn across the viewport; without one it is the one round the points
+	void setBounds(double xMin, double yMin, double size);
+
+	void updatePoints(const std::vector<XYZ> &points);
+
+	/*
+	only the points at the indices in changed are new, the rest are as the
+	last update had them; the bounds stay as they are
+	*/
+	void updatePoints(const std::vector<XYZ> &points, const std::vector<int> &changed);
+
+	/*
+	the edges drawn by drawEdges(), two indices in each of three slots per
+	triangle (24 bytes), so a triangle that stays keeps its edges in place;
+	an edge shared by two triangles is drawn from the one where it runs from
+	the lower index and the other slot repeats a point
+	*/
+	void updateEdges(const std::vector<Triangle> &triangles);
+
+	/*
+	only the triangles at the slots in changed are new, the rest are as the
+	last update had them; the edges of the changed slots and of the slots
+	across from them are all that is looked at and sent
+	*/
+	void updateEdges(const std::vector<Triangle> &triangles, const std::vector<int> &changed);
+
+	// x and y scale, then x and y offset, for the transform uniform
+	void transform(GLfloat result[4]) const;
+
+	void drawEdges();
+
+	bool persistent() const { return positions.persistent(); }
+	size_t uploadedBytes() const { return positions.uploadedBytes + edges.uploadedBytes; }
+	int uploadCalls() const { return positions.uploadCalls + edges.uploadCalls; }
+	size_t pointBytes() const { return positions.bytes(); }
+	size_t indexBytes() const { return edges.bytes(); }
+
+private:
+	bool quantized;
+	bool fixedBounds;
+	double xMin, yMin, size;
+
+	GLuint VAO;
+	StreamBuffer positions, edges;
+	GLsizei edgeIndexNumber;
+
+	std::vector<GLuint> packed, lines;
+
+	/*
+	The triangle of each slot as the edges were last made from, and every
+	directed edge of them with its slot in an open addressing table at most
+	half full, both kept between updates to be patched
+	*/
+	std::vector<Triangle> held;
+	std::vector<std::pair<unsigned long long, int>> table;
+	std::vector<int> touched;
+
+	void pack(const XYZ &point, size_t index);
+	void sendPoints();
+	void bindPoints();
+
+	int findEdge(GLuint a, GLuint b) const;
+	void addEdges(int slot);
+	void removeEdges(int slot);
+	void writeLines(int slot);
+	void rehash();
+};
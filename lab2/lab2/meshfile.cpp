@@ -0,0 +1,403 @@
+#include "meshfile.h"
+#include <cstring>
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const unsigned MeshWriter::ADJACENCY;
+const unsigned MeshWriter::COMPRESSED;
+
+static const char MAGIC[8] = { 'L', 'A', 'B', '2', 'M', 'E', 'S', 'H' };
+static const uint32_t VERSION = 1;
+static const size_t HEADER_SIZE = 48;
+static const size_t BLOCK_SIZE = 1 << 20;
+
+static_assert(sizeof(XYZ) == 3 * sizeof(double), "points are stored as they are in memory");
+static_assert(sizeof(Triangle) == 3 * sizeof(int32_t), "triangles are stored as they are in memory");
+
+struct Header {
+	char magic[8];
+	uint32_t version, flags;
+	uint64_t pointNumber, triangleNumber;
+	uint64_t triangleBytes, neighbourBytes;
+};
+
+static_assert(sizeof(Header) == HEADER_SIZE, "the header has no padding");
+
+MeshWriter::MeshWriter() : flags(0), pointNumber(0), triangleNumber(0), triangleBytes(0), lastIndex(0), failed(false) {
+}
+
+MeshWriter::~MeshWriter() {
+	if (file.is_open())
+		close();
+}
+
+bool MeshWriter::open(const char *path, unsigned fileFlags) {
+	if (file.is_open())
+		close();
+
+	file.open(path, std::ios::binary | std::ios::trunc);
+	flags = fileFlags;
+	pointNumber = triangleNumber = triangleBytes = 0;
+	lastIndex = 0;
+	failed = !file.is_open();
+	block.clear();
+	neighbourList.clear();
+
+	if (failed) {
+		std::cout << "ERROR::MESHFILE::CANNOT_CREATE " << path << std::endl;
+		return false;
+	}
+
+	// a blank header until close() knows the counts
+	char blank[HEADER_SIZE] = {};
+	put(blank, HEADER_SIZE);
+	return true;
+}
+
+void MeshWriter::flush() {
+	if (!block.empty() && !file.write(block.data(), block.size()))
+		failed = true;
+	block.clear();
+}
+
+void MeshWriter::put(const void *data, size_t size) {
+	if (block.size() + size > BLOCK_SIZE)
+		flush();
+
+	auto bytes = static_cast<const char*>(data);
+	block.insert(block.end(), bytes, bytes + size);
+}
+
+// zigzag, so that small negative values are short too, then seven bits a byte
+void MeshWriter::putVarint(int value) {
+	auto code = (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+	unsigned char bytes[5];
+	size_t length = 0;
+
+	while (code >= 0x80) {
+		bytes[length++] = static_cast<unsigned char>(code | 0x80);
+		code >>= 7;
+	}
+	bytes[length++] = static_cast<unsigned char>(code);
+
+	put(bytes, length);
+	triangleBytes += length;
+}
+
+bool MeshWriter::point(const XYZ &point) {
+	if (triangleNumber > 0)
+		return false;
+
+	put(&point, sizeof(XYZ));
+	pointNumber++;
+	return true;
+}
+
+void MeshWriter::triangle(const Triangle &triangle, const int *neighbour) {
+	if (flags & COMPRESSED) {
+		putVarint(triangle.p1 - lastIndex);
+		putVarint(triangle.p2 - triangle.p1);
+		putVarint(triangle.p3 - triangle.p2);
+		lastIndex = triangle.p3;
+	}
+	else {
+		put(&triangle, sizeof(Triangle));
+		triangleBytes += sizeof(Triangle);
+	}
+
+	if (flags & ADJACENCY)
+		for (int k = 0; k < 3; k++)
+			neighbourList.push_back(neighbour ? neighbour[k] : -1);
+
+	triangleNumber++;
+}
+
+bool MeshWriter::close() {
+	if (!file.is_open())
+		return false;
+
+	uint64_t neighbourBytes = 0;
+
+	if (flags & ADJACENCY) {
+		if (flags & COMPRESSED) {
+			auto before = triangleBytes;
+
+			for (size_t i = 0; i < neighbourList.size(); i++)
+				putVarint(neighbourList[i] - static_cast<int>(i / 3));
+			neighbourBytes = triangleBytes - before;
+			triangleBytes = before;
+		}
+		else {
+			put(neighbourList.data(), neighbourList.size() * sizeof(int));
+			neighbourBytes = neighbourList.size() * sizeof(int);
+		}
+	}
+	flush();
+
+	Header header;
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.flags = flags;
+	header.pointNumber = pointNumber;
+	header.triangleNumber = triangleNumber;
+	header.triangleBytes = triangleBytes;
+	header.neighbourBytes = neighbourBytes;
+
+	file.seekp(0);
+	if (!file.write(reinterpret_cast<const char*>(&header), sizeof(header)))
+		failed = true;
+	file.close();
+
+	neighbourList.clear();
+	neighbourList.shrink_to_fit();
+
+	return !failed;
+}
+
+bool MeshWriter::write(const char *path, const std::vector<XYZ> &points, const std::vector<Triangle> &triangles, unsigned flags) {
+	MeshWriter writer;
+	std::vector<int> adjacent;
+
+	if (!writer.open(path, flags))
+		return false;
+
+	if (flags & ADJACENCY)
+		Triangulate::neighbours(triangles.data(), static_cast<int>(triangles.size()), adjacent);
+
+	for (auto &point : points)
+		writer.point(point);
+	for (size_t t = 0; t < triangles.size(); t++)
+		writer.triangle(triangles[t], (flags & ADJACENCY) ? &adjacent[3 * t] : nullptr);
+
+	return writer.close();
+}
+
+MeshReader::MeshReader() : base(nullptr), size(0), pointTotal(0), triangleTotal(0),
+	pointData(nullptr), triangleData(nullptr), neighbourData(nullptr) {
+}
+
+MeshReader::~MeshReader() {
+	close();
+}
+
+// map the whole file read only; the handles aren't needed once the view exists
+bool MeshReader::map(const char *path) {
+#ifdef _WIN32
+	auto fileHandle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+		CloseHandle(fileHandle);
+		return false;
+	}
+
+	auto mapping = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(fileHandle);
+	if (!mapping)
+		return false;
+
+	base = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	CloseHandle(mapping);
+
+	size = static_cast<size_t>(fileSize.QuadPart);
+#else
+	auto descriptor = ::open(path, O_RDONLY);
+	if (descriptor < 0)
+		return false;
+
+	struct stat status;
+	if (fstat(descriptor, &status) != 0 || status.st_size == 0) {
+		::close(descriptor);
+		return false;
+	}
+
+	auto view = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+	::close(descriptor);
+
+	base = view == MAP_FAILED ? nullptr : static_cast<const char*>(view);
+	size = static_cast<size_t>(status.st_size);
+#endif
+
+	return base != nullptr;
+}
+
+void MeshReader::close() {
+	if (base) {
+#ifdef _WIN32
+		UnmapViewOfFile(base);
+#else
+		munmap(const_cast<char*>(base), size);
+#endif
+	}
+
+	base = nullptr;
+	size = 0;
+	pointTotal = triangleTotal = 0;
+	pointData = nullptr;
+	triangleData = nullptr;
+	neighbourData = nullptr;
+	decodedTriangles.clear();
+	decodedNeighbours.clear();
+}
+
+// read count varints from data, which holds bytes of them; FALSE if they don't fit exactly
+static bool decode(const unsigned char *data, size_t bytes, size_t count, std::vector<int> &result) {
+	auto end = data + bytes;
+	result.resize(count);
+
+	for (size_t i = 0; i < count; i++) {
+		uint32_t code = 0;
+		int shift = 0;
+
+		for (;;) {
+			if (data == end || shift > 28)
+				return false;
+
+			auto byte = *data++;
+			code |= static_cast<uint32_t>(byte & 0x7F) << shift;
+			shift += 7;
+
+			if (!(byte & 0x80))
+				break;
+		}
+
+		result[i] = static_cast<int>(code >> 1) ^ -static_cast<int>(code & 1);
+	}
+
+	return data == end;
+}
+
+// every corner a point and every neighbour a triangle or -1; FALSE at the first that isn't
+static bool inRange(const Triangle *triangles, const int *neighbours, size_t triangleNumber, size_t pointNumber) {
+	for (size_t t = 0; t < triangleNumber; t++) {
+		const int corner[3] = { triangles[t].p1, triangles[t].p2, triangles[t].p3 };
+
+		for (int k = 0; k < 3; k++) {
+			if (corner[k] < 0 || static_cast<size_t>(corner[k]) >= pointNumber)
+				return false;
+			if (neighbours && (neighbours[3 * t + k] < -1 || (neighbours[3 * t + k] >= 0 && static_cast<size_t>(neighbours[3 * t + k]) >= triangleNumber)))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+bool MeshReader::open(const char *path) {
+	close();
+
+	if (!map(path)) {
+		std::cout << "ERROR::MESHFILE::CANNOT_MAP " << path << std::endl;
+		return false;
+	}
+
+	Header header;
+	auto valid = size >= HEADER_SIZE;
+
+	if (valid) {
+		memcpy(&header, base, sizeof(header));
+
+		// the sections have to account for the whole file
+		auto pointBytes = header.pointNumber * sizeof(XYZ);
+		valid = memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 && header.version == VERSION
+			&& header.pointNumber <= size / sizeof(XYZ) && header.triangleNumber <= size / 3
+			&& header.triangleBytes <= size && header.neighbourBytes <= size
+			&& HEADER_SIZE + pointBytes + header.triangleBytes + header.neighbourBytes == size;
+
+		if (valid && !(header.flags & MeshWriter::COMPRESSED))
+			valid = header.triangleBytes == header.triangleNumber * sizeof(Triangle)
+				&& header.neighbourBytes == ((header.flags & MeshWriter::ADJACENCY) ? header.triangleNumber * 3 * sizeof(int) : 0);
+		else if (valid)
+			valid = header.triangleBytes >= 3 * header.triangleNumber
+				&& ((header.flags & MeshWriter::ADJACENCY) ? header.neighbourBytes >= 3 * header.triangleNumber : header.neighbourBytes == 0);
+	}
+
+	if (!valid) {
+		std::cout << "ERROR::MESHFILE::NOT_A_MESH_FILE " << path << std::endl;
+		close();
+		return false;
+	}
+
+	pointTotal = static_cast<size_t>(header.pointNumber);
+	triangleTotal = static_cast<size_t>(header.triangleNumber);
+
+	auto section = base + HEADER_SIZE;
+	pointData = reinterpret_cast<const XYZ*>(section);
+	section += pointTotal * sizeof(XYZ);
+
+	if (!(header.flags & MeshWriter::COMPRESSED)) {
+		triangleData = reinterpret_cast<const Triangle*>(section);
+		if (header.flags & MeshWriter::ADJACENCY)
+			neighbourData = reinterpret_cast<const int*>(section + header.triangleBytes);
+		valid = inRange(triangleData, neighbourData, triangleTotal, pointTotal);
+	}
+	else
+		valid = decodeSections(section, static_cast<size_t>(header.triangleBytes),
+			(header.flags & MeshWriter::ADJACENCY) ? static_cast<size_t>(header.neighbourBytes) : 0);
+
+	if (!valid) {
+		std::cout << "ERROR::MESHFILE::BAD_INDICES " << path << std::endl;
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+/*
+undo the differences of a compressed file; the sums are taken in 64 bits
+and each has to land on a point, or on a triangle or -1 for a neighbour,
+so a corrupt difference fails here instead of wrapping round
+*/
+bool MeshReader::decodeSections(const char *section, size_t triangleBytes, size_t neighbourBytes) {
+	std::vector<int> values;
+	auto bytes = reinterpret_cast<const unsigned char*>(section);
+
+	if (!decode(bytes, triangleBytes, 3 * triangleTotal, values))
+		return false;
+
+	long long last = 0;
+	auto valid = true;
+	auto next = [&](size_t i) {
+		last += values[i];
+		valid = valid && last >= 0 && static_cast<unsigned long long>(last) < pointTotal;
+		return static_cast<int>(last);
+	};
+
+	decodedTriangles.resize(triangleTotal);
+	for (size_t t = 0; valid && t < triangleTotal; t++) {
+		decodedTriangles[t].p1 = next(3 * t);
+		decodedTriangles[t].p2 = next(3 * t + 1);
+		decodedTriangles[t].p3 = next(3 * t + 2);
+	}
+	triangleData = decodedTriangles.data();
+
+	if (!valid || neighbourBytes == 0)
+		return valid;
+
+	if (!decode(bytes + triangleBytes, neighbourBytes, 3 * triangleTotal, decodedNeighbours))
+		return false;
+
+	for (size_t i = 0; i < decodedNeighbours.size(); i++) {
+		auto neighbour = static_cast<long long>(decodedNeighbours[i]) + static_cast<long long>(i / 3);
+		if (neighbour < -1 || neighbour >= static_cast<long long>(triangleTotal))
+			return false;
+
+		decodedNeighbours[i] = static_cast<int>(neighbour);
+	}
+	neighbourData = decodedNeighbours.data();
+
+	return true;
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include "triangulate.h"
+
+/*
+Binary mesh files: a 48 byte header, the points as XYZ, the triangles as
+Triangle and optionally the neighbours of every triangle, all little endian
+and laid out the way they are in memory, so a reader can use them in place.
+
+	char magic[8]              "LAB2MESH"
+	uint32 version, flags      ADJACENCY, COMPRESSED
+	uint64 pointNumber, triangleNumber
+	uint64 triangleBytes, neighbourBytes
+
+Compressed, the triangle indices are stored as the difference from the
+index before them and a neighbour as the difference from its own triangle,
+zigzag and varint coded; those sections are decoded on reading.
+*/
+class MeshWriter {
+public:
+	static const unsigned ADJACENCY = 1; // neighbour across p1p2, p2p3 and p3p1 of each triangle, -1 on the hull
+	static const unsigned COMPRESSED = 2;
+
+	MeshWriter();
+	~MeshWriter();
+
+	bool open(const char *path, unsigned flags);
+
+	// all the points go before the first triangle; FALSE if one comes after
+	bool point(const XYZ &point);
+
+	// without ADJACENCY neighbour is ignored and may be nullptr
+	void triangle(const Triangle &triangle, const int *neighbour = nullptr);
+
+	// write the counts to the header and the neighbours, which are held until now; FALSE if any write failed
+	bool close();
+
+	// points and triangles in one go, with the neighbours from Triangulate::neighbours for ADJACENCY
+	static bool write(const char *path, const std::vector<XYZ> &points, const std::vector<Triangle> &triangles, unsigned flags);
+
+private:
+	std::ofstream file;
+	unsigned flags;
+	uint64_t pointNumber, triangleNumber, triangleBytes;
+	int lastIndex;
+	bool failed;
+
+	std::vector<char> block; // written out when full
+	std::vector<int> neighbourList;
+
+	void put(const void *data, size_t size);
+	void putVarint(int value);
+	void flush();
+
+	MeshWriter(const MeshWriter &) = delete;
+	MeshWriter &operator=(const MeshWriter &) = delete;
+};
+
+/*
+A mesh file mapped into memory: the points, and the triangles and neighbours
+of an uncompressed file, point straight into the mapping and are not copied.
+They stay valid until close() or the reader is destroyed
+*/
+class MeshReader {
+public:
+	MeshReader();
+	~MeshReader();
+
+	/*
+	FALSE if the file can't be mapped, isn't a whole mesh file, or has a
+	corner that isn't one of its points or a neighbour that isn't one of
+	its triangles or -1
+	*/
+	bool open(const char *path);
+	void close();
+
+	size_t pointNumber() const { return pointTotal; }
+	size_t triangleNumber() const { return triangleTotal; }
+
+	const XYZ *points() const { return pointData; }
+	const Triangle *triangles() const { return triangleData; }
+
+	// nullptr for a file without ADJACENCY
+	const int *neighbours() const { return neighbourData; }
+
+private:
+	const char *base;
+	size_t size;
+
+	size_t pointTotal, triangleTotal;
+	const XYZ *pointData;
+	const Triangle *triangleData;
+	const int *neighbourData;
+
+	// the sections of a compressed file, decoded
+	std::vector<Triangle> decodedTriangles;
+	std::vector<int> decodedNeighbours;
+
+	bool map(const char *path);
+	bool decodeSections(const char *section, size_t triangleBytes, size_t neighbourBytes);
+
+	MeshReader(const MeshReader &) = delete;
+	MeshReader &operator=(const MeshReader &) = delete;
+};
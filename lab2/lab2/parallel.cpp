@@ -0,0 +1,387 @@
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <thread>
+
+// thrown when the edges outgrow the chunks sized up front, so the whole split unwinds
+struct OutOfChunks {};
+
+/*
+Quad-edge storage. Edge e of quad q is q * 4 + r, r = 0..3 is its rotation:
+0 and 2 are the two directions of the primal edge, 1 and 3 are the dual.
+The arrays are split into fixed chunks so that threads working on
+different halves can take new chunks without ever moving old ones.
+*/
+class QuadEdges {
+public:
+	static const int CHUNK_SHIFT = 14;
+	static const int CHUNK_SIZE = 1 << CHUNK_SHIFT; // edges per chunk
+	static const int CHUNK_MASK = CHUNK_SIZE - 1;
+
+	struct Chunk {
+		int next[CHUNK_SIZE];
+		int org[CHUNK_SIZE];
+	};
+
+	// each thread allocates from its own free list and current chunk
+	struct Allocator {
+		std::vector<int> freeQuads;
+		int current = 0;
+		int end = 0;
+	};
+
+	const XYZ *points;
+
+	QuadEdges(const XYZ *_points, size_t chunksMax) : points(_points), chunks(chunksMax), chunkNumber(0) {}
+
+	int &next(int e) { return chunks[e >> CHUNK_SHIFT]->next[e & CHUNK_MASK]; }
+	int &org(int e) { return chunks[e >> CHUNK_SHIFT]->org[e & CHUNK_MASK]; }
+
+	static int rot(int e) { return (e & ~3) | ((e + 1) & 3); }
+	static int invRot(int e) { return (e & ~3) | ((e + 3) & 3); }
+	static int sym(int e) { return e ^ 2; }
+
+	int dest(int e) { return org(sym(e)); }
+	int onext(int e) { return next(e); }
+	int oprev(int e) { return rot(next(rot(e))); }
+	int lnext(int e) { return rot(next(invRot(e))); }
+	int rprev(int e) { return next(sym(e)); }
+
+	int chunksUsed() const { return chunkNumber.load(); }
+	bool alive(int e) { return org(e & ~3) != -1; }
+
+	int makeEdge(Allocator &allocator, int from, int to) {
+		int q;
+
+		if (!allocator.freeQuads.empty()) {
+			q = allocator.freeQuads.back();
+			allocator.freeQuads.pop_back();
+		}
+		else {
+			if (allocator.current == allocator.end) {
+				int chunk = chunkNumber++;
+				assert(static_cast<size_t>(chunk) < chunks.size());
+				if (static_cast<size_t>(chunk) >= chunks.size())
+					throw OutOfChunks();
+
+				chunks[chunk].reset(new Chunk);
+				std::fill(chunks[chunk]->org, chunks[chunk]->org + CHUNK_SIZE, -1);
+				allocator.current = chunk * (CHUNK_SIZE / 4);
+				allocator.end = allocator.current + CHUNK_SIZE / 4;
+			}
+			q = allocator.current++;
+		}
+
+		int e = q * 4;
+		next(e + 0) = e + 0;
+		next(e + 1) = e + 3;
+		next(e + 2) = e + 2;
+		next(e + 3) = e + 1;
+		org(e + 0) = from;
+		org(e + 1) = 0;
+		org(e + 2) = to;
+		org(e + 3) = 0;
+
+		return e;
+	}
+
+	void splice(int a, int b) {
+		int alpha = rot(next(a));
+		int beta = rot(next(b));
+
+		std::swap(next(a), next(b));
+		std::swap(next(alpha), next(beta));
+	}
+
+	// add an edge from the destination of a to the origin of b
+	int connect(Allocator &allocator, int a, int b) {
+		int e = makeEdge(allocator, dest(a), org(b));
+
+		splice(e, lnext(a));
+		splice(sym(e), b);
+
+		return e;
+	}
+
+	void deleteEdge(Allocator &allocator, int e) {
+		splice(e, oprev(e));
+		splice(sym(e), oprev(sym(e)));
+
+		org(e & ~3) = -1;
+		allocator.freeQuads.push_back(e >> 2);
+	}
+
+	bool ccw(int a, int b, int c) { return Triangulate::orientation(points[a], points[b], points[c]) > 0.0; }
+	bool rightOf(int p, int e) { return ccw(p, dest(e), org(e)); }
+	bool leftOf(int p, int e) { return ccw(p, org(e), dest(e)); }
+
+	bool inCircle(int a, int b, int c, int d) {
+		return Triangulate::inCircle(points[a], points[b], points[c], points[d]) > 0.0;
+	}
+
+private:
+	std::vector<std::unique_ptr<Chunk> > chunks;
+	std::atomic<int> chunkNumber;
+};
+
+
+/*
+Triangulate the sorted points [lo, hi), hi - lo >= 2
+Returns the counterclockwise convex hull edge out of the leftmost point
+in "left" and the clockwise one out of the rightmost point in "right"
+*/
+static void delaunay(QuadEdges &mesh, QuadEdges::Allocator &allocator, int lo, int hi,
+	int depth, int &left, int &right) {
+
+	auto n = hi - lo;
+
+	if (n == 2) {
+		auto a = mesh.makeEdge(allocator, lo, lo + 1);
+		left = a;
+		right = QuadEdges::sym(a);
+		return;
+	}
+
+	if (n == 3) {
+		auto a = mesh.makeEdge(allocator, lo, lo + 1);
+		auto b = mesh.makeEdge(allocator, lo + 1, lo + 2);
+		mesh.splice(QuadEdges::sym(a), b);
+
+		if (mesh.ccw(lo, lo + 1, lo + 2)) {
+			mesh.connect(allocator, b, a);
+			left = a;
+			right = QuadEdges::sym(b);
+		}
+		else if (mesh.ccw(lo, lo + 2, lo + 1)) {
+			auto c = mesh.connect(allocator, b, a);
+			left = QuadEdges::sym(c);
+			right = c;
+		}
+		else {
+			// the three points are collinear
+			left = a;
+			right = QuadEdges::sym(b);
+		}
+		return;
+	}
+
+	auto mid = lo + n / 2;
+	int ldo, ldi, rdi, rdo;
+
+	// the left half goes to a new thread while there are threads to spare
+	if (depth > 0) {
+		QuadEdges::Allocator leftAllocator;
+		auto leftFailed = false;
+		std::thread worker([&]() {
+			try {
+				delaunay(mesh, leftAllocator, lo, mid, depth - 1, ldo, ldi);
+			}
+			catch (const OutOfChunks &) {
+				leftFailed = true;
+			}
+		});
+
+		// the worker has to be joined whichever half runs out
+		try {
+			delaunay(mesh, allocator, mid, hi, depth - 1, rdi, rdo);
+		}
+		catch (const OutOfChunks &) {
+			worker.join();
+			throw;
+		}
+		worker.join();
+
+		if (leftFailed)
+			throw OutOfChunks();
+
+		allocator.freeQuads.insert(allocator.freeQuads.end(),
+			leftAllocator.freeQuads.begin(), leftAllocator.freeQuads.end());
+	}
+	else {
+		delaunay(mesh, allocator, lo, mid, 0, ldo, ldi);
+		delaunay(mesh, allocator, mid, hi, 0, rdi, rdo);
+	}
+
+	// compute the lower common tangent of the two halves
+	while (true) {
+		if (mesh.leftOf(mesh.org(rdi), ldi))
+			ldi = mesh.lnext(ldi);
+		else if (mesh.rightOf(mesh.org(ldi), rdi))
+			rdi = mesh.rprev(rdi);
+		else
+			break;
+	}
+
+	auto basel = mesh.connect(allocator, QuadEdges::sym(rdi), ldi);
+	if (mesh.org(ldi) == mesh.org(ldo))
+		ldo = QuadEdges::sym(basel);
+	if (mesh.org(rdi) == mesh.org(rdo))
+		rdo = basel;
+
+	// zip the halves together from the bottom up
+	while (true) {
+		auto lcand = mesh.onext(QuadEdges::sym(basel));
+		auto lvalid = mesh.rightOf(mesh.dest(lcand), basel);
+
+		if (lvalid) {
+			while (mesh.inCircle(mesh.dest(basel), mesh.org(basel), mesh.dest(lcand), mesh.dest(mesh.onext(lcand)))) {
+				auto t = mesh.onext(lcand);
+				mesh.deleteEdge(allocator, lcand);
+				lcand = t;
+			}
+		}
+
+		auto rcand = mesh.oprev(basel);
+		auto rvalid = mesh.rightOf(mesh.dest(rcand), basel);
+
+		if (rvalid) {
+			while (mesh.inCircle(mesh.dest(basel), mesh.org(basel), mesh.dest(rcand), mesh.dest(mesh.oprev(rcand)))) {
+				auto t = mesh.oprev(rcand);
+				mesh.deleteEdge(allocator, rcand);
+				rcand = t;
+			}
+		}
+
+		if (!lvalid && !rvalid)
+			break;
+
+		if (!lvalid || (rvalid && mesh.inCircle(mesh.dest(lcand), mesh.org(lcand), mesh.org(rcand), mesh.dest(rcand))))
+			basel = mesh.connect(allocator, rcand, QuadEdges::sym(basel));
+		else
+			basel = mesh.connect(allocator, QuadEdges::sym(basel), QuadEdges::sym(lcand));
+	}
+
+	left = ldo;
+	right = rdo;
+}
+
+// sort [begin, end) on "parts" threads, then merge the sorted runs pairwise
+template<class Iterator, class Compare>
+static void parallelSort(Iterator begin, Iterator end, Compare compare, int parts) {
+	auto size = end - begin;
+	std::vector<Iterator> bounds;
+
+	for (auto i = 0; i <= parts; i++)
+		bounds.push_back(begin + size * i / parts);
+
+	std::vector<std::thread> workers;
+	for (auto i = 0; i < parts; i++)
+		workers.push_back(std::thread([&bounds, &compare, i]() { std::sort(bounds[i], bounds[i + 1], compare); }));
+	for (auto &worker : workers)
+		worker.join();
+
+	for (auto step = 1; step < parts; step *= 2) {
+		workers.clear();
+		for (auto i = 0; i + step < parts; i += 2 * step) {
+			auto first = bounds[i], middle = bounds[i + step], last = bounds[std::min(i + 2 * step, parts)];
+			workers.push_back(std::thread([first, middle, last, &compare]() { std::inplace_merge(first, middle, last, compare); }));
+		}
+		for (auto &worker : workers)
+			worker.join();
+	}
+}
+
+int ParallelTriangulate::triangulate(int pointNumb, const XYZ *xyz, Triangle *triangles, int threadNumber) {
+	if (threadNumber <= 0)
+		threadNumber = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+	// sort by x, then y, dropping coincident points
+	std::vector<int> order(pointNumb);
+	for (int i = 0; i < pointNumb; i++)
+		order[i] = i;
+
+	parallelSort(order.begin(), order.end(), [xyz](int i, int j) {
+		if (xyz[i].x != xyz[j].x) return xyz[i].x < xyz[j].x;
+		if (xyz[i].y != xyz[j].y) return xyz[i].y < xyz[j].y;
+		return i < j;
+	}, threadNumber);
+
+	std::vector<XYZ> points;
+	std::vector<int> ids;
+	points.reserve(pointNumb);
+	ids.reserve(pointNumb);
+
+	for (auto i : order) {
+		if (!points.empty() && points.back().x == xyz[i].x && points.back().y == xyz[i].y)
+			continue;
+		points.push_back(xyz[i]);
+		ids.push_back(i);
+	}
+
+	auto n = static_cast<int>(points.size());
+	if (n < 3)
+		return 0;
+
+	// depth of the thread tree
+	int depth = 0;
+	while ((1 << (depth + 1)) <= threadNumber && (n >> (depth + 1)) >= 1024)
+		depth++;
+
+	// upper bound on chunks ever taken: every merge level adds at most n edges
+	size_t levels = 2;
+	while ((static_cast<size_t>(1) << levels) < static_cast<size_t>(n))
+		levels++;
+	auto chunksMax = (static_cast<size_t>(n) * 4 * (levels + 3)) / QuadEdges::CHUNK_SIZE + (2 << depth) + 1;
+
+	QuadEdges mesh(points.data(), chunksMax);
+	QuadEdges::Allocator allocator;
+	int left, right;
+
+	// if the bound above ever falls short, the sequential engine still gives the right answer
+	try {
+		delaunay(mesh, allocator, 0, n, depth, left, right);
+	}
+	catch (const OutOfChunks &) {
+		return Triangulate::triangulate(pointNumb, xyz, triangles);
+	}
+
+	/*
+	Collect the triangles: the faces to the left of a primal edge that close
+	after three steps and are counterclockwise. A face is owned by its
+	smallest edge, so the chunks can be scanned in parallel without marks.
+	*/
+	auto edgesUsed = mesh.chunksUsed() * QuadEdges::CHUNK_SIZE;
+	std::vector<std::vector<Triangle> > found(threadNumber);
+	std::vector<std::thread> workers;
+
+	for (int t = 0; t < threadNumber; t++) {
+		workers.push_back(std::thread([&, t]() {
+			auto begin = static_cast<int>(static_cast<long long>(edgesUsed) * t / threadNumber) & ~3;
+			auto end = static_cast<int>(static_cast<long long>(edgesUsed) * (t + 1) / threadNumber) & ~3;
+			if (t == threadNumber - 1)
+				end = edgesUsed;
+
+			for (int q = begin; q < end; q += 4) {
+				if (!mesh.alive(q))
+					continue;
+
+				for (int e = q; e < q + 4; e += 2) {
+					auto f = mesh.lnext(e);
+					auto g = mesh.lnext(f);
+
+					if (mesh.lnext(g) != e || f < e || g < e)
+						continue;
+					if (!mesh.ccw(mesh.org(e), mesh.org(f), mesh.org(g)))
+						continue;
+
+					Triangle triangle;
+					triangle.p1 = ids[mesh.org(e)];
+					triangle.p2 = ids[mesh.org(g)];
+					triangle.p3 = ids[mesh.org(f)];
+					found[t].push_back(triangle);
+				}
+			}
+		}));
+	}
+	for (auto &worker : workers)
+		worker.join();
+
+	int triangleNumber = 0;
+	for (auto &part : found)
+		for (auto &triangle : part)
+			triangles[triangleNumber++] = triangle;
+
+	return triangleNumber;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <algorithm>
+#include <thread>
+#include "triangulate.h"
+
+/*
+Divide-and-conquer Delaunay triangulation (Guibas & Stolfi) on a quad-edge mesh.
+The sorted point set is split in halves by x, the halves are triangulated
+on separate threads down to threadNumber leaves and then merged back.
+The result is in the same form as Triangulate::triangulate gives.
+*/
+class ParallelTriangulate {
+public:
+	/*
+	Takes as input pointNumb vertices in array xyz, in any order
+	The triangles are arranged in a consistent clockwise order
+	The triangle array "triangles" should be malloced to 2 * pointNumb
+	Coincident points are triangulated once, under the smallest index
+	threadNumber = 0 uses every hardware thread
+	If the quad-edge storage sized from pointNumb ever runs out, the points
+	are triangulated again by Triangulate::triangulate
+	*/
+	static int triangulate(int pointNumb, const XYZ *xyz, Triangle *triangles, int threadNumber = 0);
+};
+
+// run work(begin, end) over [0, count) in one contiguous part per thread, threadNumber = 0 for every hardware thread
+template <typename Work>
+void inParallel(size_t count, int threadNumber, Work work) {
+	if (threadNumber <= 0)
+		threadNumber = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+	threadNumber = static_cast<int>(std::min<size_t>(threadNumber, std::max<size_t>(count / 1024, 1)));
+
+	std::vector<std::thread> workers;
+	for (int t = 1; t < threadNumber; t++)
+		workers.push_back(std::thread(work, count * t / threadNumber, count * (t + 1) / threadNumber));
+
+	work(0, count / threadNumber);
+
+	for (auto &worker : workers)
+		worker.join();
+}
@@ -0,0 +1,246 @@
+#include "profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+std::atomic<bool> Profiler::on(false);
+
+// a phase from begin to value, or a counter set to value at begin
+struct ProfileEvent {
+	const char *name;
+	long long begin, value;
+	bool counter;
+};
+
+// written by one thread only; written counts every event ever, the ring keeps the last RING
+struct ProfileRing {
+	std::vector<ProfileEvent> events;
+	std::atomic<unsigned long long> written;
+	int thread;
+	std::string name;
+
+	ProfileRing(int thread) : events(Profiler::RING), written(0), thread(thread) {}
+};
+
+struct ProfileQuery {
+	GLuint query;
+	const char *name;
+	long long begin;
+};
+
+static std::mutex ringsLock;
+static std::vector<std::unique_ptr<ProfileRing>> rings;
+static thread_local ProfileRing *localRing = nullptr;
+static long long epoch = 0;
+
+// GPU times; GL is used from the window's thread only, so are these
+static ProfileRing *gpuRing = nullptr;
+static std::vector<GLuint> freeQueries;
+static std::deque<ProfileQuery> pending;
+static bool gpuOpen = false;
+
+// ns each, of the window's thread
+static long long frameTimes[Profiler::FRAMES];
+static long long frameCount = 0, lastFrame = 0;
+
+static ProfileRing &newRing(const char *name) {
+	std::lock_guard<std::mutex> lock(ringsLock);
+	rings.emplace_back(new ProfileRing(static_cast<int>(rings.size()) + 1));
+	if (name)
+		rings.back()->name = name;
+	else
+		rings.back()->name = "thread " + std::to_string(rings.size());
+	return *rings.back();
+}
+
+static ProfileRing &ring() {
+	if (!localRing)
+		localRing = &newRing(nullptr);
+	return *localRing;
+}
+
+static void push(ProfileRing &ring, const ProfileEvent &event) {
+	auto written = ring.written.load(std::memory_order_relaxed);
+	ring.events[written % Profiler::RING] = event;
+	ring.written.store(written + 1, std::memory_order_release);
+}
+
+long long Profiler::now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::start() {
+	if (!epoch)
+		epoch = now();
+	on.store(true, std::memory_order_relaxed);
+}
+
+void Profiler::stop() {
+	on.store(false, std::memory_order_relaxed);
+}
+
+void Profiler::nameThread(const char *name) {
+	if (!localRing) {
+		localRing = &newRing(name);
+		return;
+	}
+	std::lock_guard<std::mutex> lock(ringsLock);
+	localRing->name = name;
+}
+
+void Profiler::phase(const char *name, long long begin, long long end) {
+	push(ring(), { name, begin, end, false });
+}
+
+void Profiler::count(const char *name, long long value) {
+	if (enabled())
+		push(ring(), { name, now(), value, true });
+}
+
+void Profiler::gpuBegin(const char *name) {
+	if (!enabled() || gpuOpen)
+		return;
+
+	GLuint query;
+	if (freeQueries.empty()) {
+		glGenQueries(1, &query);
+	} else {
+		query = freeQueries.back();
+		freeQueries.pop_back();
+	}
+
+	glBeginQuery(GL_TIME_ELAPSED, query);
+	pending.push_back({ query, name, now() });
+	gpuOpen = true;
+}
+
+void Profiler::gpuEnd() {
+	if (!gpuOpen)
+		return;
+	glEndQuery(GL_TIME_ELAPSED);
+	gpuOpen = false;
+}
+
+void Profiler::collect() {
+	// The GPU runs the commands some time after they were issued; only their length is measured, they are drawn from the time they were issued
+	while (pending.size() > (gpuOpen ? 1u : 0u)) {
+		auto &query = pending.front();
+		GLint available = 0;
+		glGetQueryObjectiv(query.query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			break;
+
+		GLuint64 time = 0;
+		glGetQueryObjectui64v(query.query, GL_QUERY_RESULT, &time);
+		if (!gpuRing)
+			gpuRing = &newRing("GPU");
+		push(*gpuRing, { query.name, query.begin, query.begin + static_cast<long long>(time), false });
+
+		freeQueries.push_back(query.query);
+		pending.pop_front();
+	}
+}
+
+void Profiler::frame() {
+	auto time = now();
+	if (lastFrame) {
+		frameTimes[frameCount % FRAMES] = time - lastFrame;
+		frameCount++;
+		if (enabled())
+			phase("frame", lastFrame, time);
+	}
+	lastFrame = time;
+}
+
+double Profiler::percentile(double p) {
+	auto n = static_cast<int>(std::min<long long>(frameCount, FRAMES));
+	if (!n)
+		return 0.0;
+
+	std::vector<long long> times(frameTimes, frameTimes + n);
+	auto k = std::min(n - 1, static_cast<int>(p * n));
+	std::nth_element(times.begin(), times.begin() + k, times.end());
+	return times[k] / 1e6;
+}
+
+std::string Profiler::histogram() {
+	static const double BOUNDS[] = { 4.0, 8.0, 12.0, 16.7, 20.0, 33.3, 50.0, 100.0 };
+	static const int BUCKETS = sizeof(BOUNDS) / sizeof(BOUNDS[0]) + 1;
+	static const int BAR = 40;
+
+	auto n = static_cast<int>(std::min<long long>(frameCount, FRAMES));
+	int counts[BUCKETS] = {};
+	auto total = 0.0, worst = 0.0;
+	for (auto i = 0; i < n; i++) {
+		auto ms = frameTimes[i] / 1e6;
+		counts[std::upper_bound(BOUNDS, BOUNDS + BUCKETS - 1, ms) - BOUNDS]++;
+		total += ms;
+		worst = std::max(worst, ms);
+	}
+
+	std::ostringstream out;
+	out << std::fixed << std::setprecision(2);
+	out << "Last " << n << " frames: mean " << (n ? total / n : 0.0) << " ms, p50 " << percentile(0.5)
+		<< ", p99 " << percentile(0.99) << ", max " << worst << std::endl;
+	for (auto i = 0; i < BUCKETS; i++) {
+		if (i < BUCKETS - 1)
+			out << "  < " << std::setw(6) << BOUNDS[i] << " ms ";
+		else
+			out << "  >=" << std::setw(6) << BOUNDS[i - 1] << " ms ";
+		out << std::setw(6) << counts[i] << " " << std::string(n ? counts[i] * BAR / n : 0, '#') << std::endl;
+	}
+	return out.str();
+}
+
+static void writeName(std::ostream &out, const std::string &name) {
+	out << '"';
+	for (auto c : name) {
+		if (c == '"' || c == '\\')
+			out << '\\';
+		out << c;
+	}
+	out << '"';
+}
+
+bool Profiler::write(const std::string &path) {
+	std::ofstream out(path);
+	if (!out) {
+		std::cout << "ERROR::PROFILER::FILE_NOT_SUCCESSFULLY_WRITTEN " << path << std::endl;
+		return false;
+	}
+
+	// Chrome's trace_event format, times in microseconds
+	out << std::fixed << std::setprecision(3);
+	out << "{\"traceEvents\":[";
+	auto first = true;
+
+	std::lock_guard<std::mutex> lock(ringsLock);
+	for (auto &ring : rings) {
+		out << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->thread << ",\"args\":{\"name\":";
+		writeName(out, ring->name);
+		out << "}}";
+		first = false;
+
+		auto written = ring->written.load(std::memory_order_acquire);
+		auto from = written > static_cast<unsigned long long>(RING) ? written - RING : 0;
+		for (auto i = from; i < written; i++) {
+			auto &event = ring->events[i % RING];
+			out << ",\n{\"name\":";
+			writeName(out, event.name);
+			out << ",\"pid\":1,\"tid\":" << ring->thread << ",\"ts\":" << (event.begin - epoch) / 1e3;
+			if (event.counter)
+				out << ",\"ph\":\"C\",\"args\":{\"value\":" << event.value << "}}";
+			else
+				out << ",\"ph\":\"X\",\"dur\":" << (event.value - event.begin) / 1e3 << "}";
+		}
+	}
+	out << "\n]}" << std::endl;
+	return static_cast<bool>(out);
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <string>
+
+#include <GL/glew.h>
+
+/*
+Where the time of a frame goes. Phases are timed by PROFILE_SCOPE, counters
+(draws, state changes) set by count(), and GPU time measured with timer
+queries between gpuBegin() and gpuEnd(). Each thread records into a ring
+of its own, without locks, keeping its newest RING events; write() saves
+them all as a Chrome trace_event JSON file, for chrome://tracing or Perfetto.
+Until start() nothing is recorded, and a scope costs one test of a flag.
+frame() marks the end of a frame; frame times go to a rolling histogram
+of the last FRAMES frames even while nothing is recorded, cheap enough to
+watch for spikes in any build
+*/
+class Profiler {
+public:
+	static const int RING = 1 << 16;
+	static const int FRAMES = 1024;
+
+	static void start();
+	static void stop();
+	static bool enabled() { return on.load(std::memory_order_relaxed); }
+
+	// the name of the calling thread in the trace
+	static void nameThread(const char *name);
+
+	class Scope {
+	public:
+		explicit Scope(const char *name) : name(enabled() ? name : nullptr), begin(this->name ? now() : 0) {}
+		~Scope() {
+			if (name)
+				phase(name, begin, now());
+		}
+
+	private:
+		const char *name;
+		long long begin;
+	};
+
+	static void count(const char *name, long long value);
+
+	// one query at a time, as GL allows; collect() reads the ones done, once a frame, without waiting
+	static void gpuBegin(const char *name);
+	static void gpuEnd();
+	static void collect();
+
+	static void frame();
+
+	// ms, of the frames in the histogram: p from 0 to 1
+	static double percentile(double p);
+	static std::string histogram();
+
+	// FALSE if the file can't be written; best after stop(), events of threads still recording may be torn
+	static bool write(const std::string &path);
+
+	// ns on a steady clock
+	static long long now();
+
+private:
+	static std::atomic<bool> on;
+
+	static void phase(const char *name, long long begin, long long end);
+};
+
+#define PROFILE_JOIN(a, b) a##b
+#define PROFILE_NAME(line) PROFILE_JOIN(profileScope, line)
+#define PROFILE_SCOPE(name) Profiler::Scope PROFILE_NAME(__LINE__)(name)
@@ -0,0 +1,260 @@
+#include "mesh.h"
+#include <algorithm>
+#include <deque>
+
+// TRUE if point is strictly inside the circle with diameter (a, b)
+static bool encroaches(const XYZ &a, const XYZ &b, const XYZ &point) {
+	return (a.x - point.x) * (b.x - point.x) + (a.y - point.y) * (b.y - point.y) < 0.0;
+}
+
+int DelaunayMesh::refine(double minAngle, double maxArea, int pointLimit) {
+	if (finiteFaces == 0)
+		return 0;
+
+	// an angle below minAngle is a circumradius above shortest edge / (2 sin minAngle)
+	auto sine = std::sin(minAngle * std::atan(1.0) / 45.0);
+	auto ratio = 1.0 / (4.0 * sine * sine);
+
+	// segments to check as (a, b, split anyway), triangles as (face, a, b, c)
+	std::deque<int> segments, bad;
+
+	for (size_t face = 0; face < faces.size(); face++) {
+		auto &f = faces[face];
+		if (f.v[0] == -1)
+			continue;
+
+		// where the domain reaches the hull that is a segment, so no vertex goes outside it
+		for (int k = 0; k < 3; k++)
+			if (f.v[k] == INFINITE && !faces[f.n[k]].exterior)
+				fix(static_cast<int>(face), k);
+	}
+
+	for (size_t face = 0; face < faces.size(); face++) {
+		auto &f = faces[face];
+		if (f.v[0] == -1)
+			continue;
+
+		for (int k = 0; k < 3; k++)
+			if ((f.fixed & (1 << k)) && static_cast<int>(face) < f.n[k]) {
+				segments.push_back(f.v[(k + 1) % 3]);
+				segments.push_back(f.v[(k + 2) % 3]);
+				segments.push_back(0);
+			}
+
+		if (!f.exterior && !isGhost(static_cast<int>(face))) {
+			bad.push_back(static_cast<int>(face));
+			bad.insert(bad.end(), f.v, f.v + 3);
+		}
+	}
+
+	// after an insertion look again at the new faces and the segments round them
+	auto queueStar = [&]() {
+		for (auto face : newFaces) {
+			auto &f = faces[face];
+
+			if (f.fixed & 4) {
+				segments.push_back(f.v[0]);
+				segments.push_back(f.v[1]);
+				segments.push_back(0);
+			}
+
+			if (!f.exterior && !isGhost(face)) {
+				bad.push_back(face);
+				bad.insert(bad.end(), f.v, f.v + 3);
+			}
+		}
+	};
+
+	/*
+	For the vertices put on segments, the two input vertices of the segment.
+	Segments are split at powers of two from input vertices, so that round a
+	small angle between segments the splits sit on common circles, and a
+	triangle between two such splits is left as it is instead of splitting
+	for ever (concentric shells)
+	*/
+	std::vector<int> ends(2 * vertices.size(), -1);
+
+	auto addEnds = [&](int vertex, int a, int b) {
+		if (ends.size() < 2 * vertices.size())
+			ends.resize(2 * vertices.size(), -1);
+
+		// a split inherits the input segment of whichever end is a split itself
+		auto from = ends[2 * a] != -1 ? a : (ends[2 * b] != -1 ? b : -1);
+		ends[2 * vertex] = from == -1 ? a : ends[2 * from];
+		ends[2 * vertex + 1] = from == -1 ? b : ends[2 * from + 1];
+	};
+
+	auto isInput = [&](int vertex) {
+		return vertex >= static_cast<int>(ends.size()) / 2 || ends[2 * vertex] == -1;
+	};
+
+	auto added = 0;
+
+	while (added < pointLimit) {
+		if (!segments.empty()) {
+			auto a = segments[0], b = segments[1], force = segments[2];
+			segments.erase(segments.begin(), segments.begin() + 3);
+
+			int k;
+			if (!alive(a) || !alive(b))
+				continue;
+			auto face = findEdge(a, b, k);
+			if (face == -1 || !(faces[face].fixed & (1 << k)))
+				continue;
+
+			// only the apexes of the two faces on a segment need a look
+			auto &pa = vertices[a];
+			auto &pb = vertices[b];
+			auto split = force != 0;
+
+			for (auto side : { face, faces[face].n[k] }) {
+				auto &f = faces[side];
+				if (f.exterior || isGhost(side))
+					continue;
+
+				for (int l = 0; l < 3; l++)
+					if (f.v[l] != a && f.v[l] != b && encroaches(pa, pb, vertices[f.v[l]]))
+						split = true;
+			}
+
+			if (!split)
+				continue;
+
+			// halve the segment, or when it hangs off one input vertex cut it at a power of two from there
+			auto t = 0.5;
+			if (isInput(a) != isInput(b)) {
+				auto length = std::sqrt((pb.x - pa.x) * (pb.x - pa.x) + (pb.y - pa.y) * (pb.y - pa.y));
+				auto shell = std::pow(2.0, std::floor(std::log2(length * 2.0 / 3.0)));
+
+				if (shell < length / 3.0)
+					shell *= 2.0;
+				t = isInput(a) ? shell / length : 1.0 - shell / length;
+			}
+
+			auto vertex = newVertex(XYZ(pa.x + t * (pb.x - pa.x), pa.y + t * (pb.y - pa.y), 0.0));
+			addEnds(vertex, a, b);
+			insertVertex(vertex, face, a, b);
+			addToGrid(vertex);
+			added++;
+
+			queueStar();
+			segments.insert(segments.end(), { a, vertex, 0, vertex, b, 0 });
+			continue;
+		}
+
+		if (bad.empty())
+			break;
+
+		auto face = bad[0];
+		int v[3] = { bad[1], bad[2], bad[3] };
+		bad.erase(bad.begin(), bad.begin() + 4);
+
+		auto &f = faces[face];
+		if (f.v[0] != v[0] || f.v[1] != v[1] || f.v[2] != v[2])
+			continue;
+
+		auto &p = vertices[v[0]];
+		auto &q = vertices[v[1]];
+		auto &r = vertices[v[2]];
+
+		auto shortest = std::min({
+			(q.x - p.x) * (q.x - p.x) + (q.y - p.y) * (q.y - p.y),
+			(r.x - q.x) * (r.x - q.x) + (r.y - q.y) * (r.y - q.y),
+			(p.x - r.x) * (p.x - r.x) + (p.y - r.y) * (p.y - r.y) });
+		// a flat triangle has no circumcentre to split at
+		XYZ centre;
+		if (!Triangulate::circumCentre(p, q, r, centre))
+			continue;
+
+		auto radius = (centre.x - p.x) * (centre.x - p.x) + (centre.y - p.y) * (centre.y - p.y);
+		auto area = Triangulate::orientation(p, q, r) / 2.0;
+
+		if (radius <= ratio * shortest && (maxArea <= 0.0 || area <= maxArea))
+			continue;
+
+		// the shortest edge between splits of two segments from one input vertex is there to stay
+		if (radius > ratio * shortest && (maxArea <= 0.0 || area <= maxArea)) {
+			auto s = 0;
+			auto edge = (q.x - p.x) * (q.x - p.x) + (q.y - p.y) * (q.y - p.y);
+			if ((r.x - q.x) * (r.x - q.x) + (r.y - q.y) * (r.y - q.y) < edge) {
+				s = 1;
+				edge = (r.x - q.x) * (r.x - q.x) + (r.y - q.y) * (r.y - q.y);
+			}
+			if ((p.x - r.x) * (p.x - r.x) + (p.y - r.y) * (p.y - r.y) < edge)
+				s = 2;
+
+			auto a = v[s], b = v[(s + 1) % 3];
+			if (!isInput(a) && !isInput(b)) {
+				auto ea = ends[2 * a], fa = ends[2 * a + 1], eb = ends[2 * b], fb = ends[2 * b + 1];
+				auto apex = (ea == eb || ea == fb) ? ea : ((fa == eb || fa == fb) ? fa : -1);
+
+				if (apex != -1 && !(ea == eb && fa == fb) && !(ea == fb && fa == eb))
+					continue;
+			}
+		}
+
+		// walk the line from the middle of the face to its circumcentre
+		XYZ middle((p.x + q.x + r.x) / 3.0, (p.y + q.y + r.y) / 3.0, 0.0);
+		auto at = face, blocked = -1, steps = 0;
+
+		while (steps++ < static_cast<int>(faces.size())) {
+			auto &g = faces[at];
+			auto next = -1;
+
+			for (int k = 0; k < 3 && next == -1; k++) {
+				auto &a = vertices[g.v[(k + 1) % 3]];
+				auto &b = vertices[g.v[(k + 2) % 3]];
+
+				if (Triangulate::orientation(a, b, centre) < 0.0
+					&& Triangulate::orientation(middle, centre, a) * Triangulate::orientation(middle, centre, b) <= 0.0)
+					next = k;
+			}
+
+			if (next == -1)
+				break;
+			if (g.fixed & (1 << next)) {
+				blocked = next;
+				break;
+			}
+			at = g.n[next];
+		}
+
+		// a segment in the way is split instead, and the triangle is tried again
+		if (blocked != -1) {
+			segments.insert(segments.end(), { faces[at].v[(blocked + 1) % 3], faces[at].v[(blocked + 2) % 3], 1 });
+			bad.insert(bad.end(), { face, v[0], v[1], v[2] });
+			continue;
+		}
+
+		auto duplicate = false;
+		for (int k = 0; k < 3; k++)
+			if (vertices[faces[at].v[k]].x == centre.x && vertices[faces[at].v[k]].y == centre.y)
+				duplicate = true;
+		if (duplicate)
+			continue;
+
+		// the circumcentre may not go in if it encroaches a segment it would be joined to
+		findCavity(centre, at, -1, -1);
+
+		auto encroached = false;
+		for (size_t i = 0; i < boundary.size(); i += 4)
+			if ((boundary[i + 3] & 2) && encroaches(vertices[boundary[i]], vertices[boundary[i + 1]], centre)) {
+				segments.insert(segments.end(), { boundary[i], boundary[i + 1], 1 });
+				encroached = true;
+			}
+
+		if (encroached) {
+			bad.insert(bad.end(), { face, v[0], v[1], v[2] });
+			continue;
+		}
+
+		auto vertex = newVertex(centre);
+		fillCavity(vertex, -1, -1);
+		addToGrid(vertex);
+		added++;
+
+		queueStar();
+	}
+
+	return added;
+}
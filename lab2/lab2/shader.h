@@ -1,82 +1,63 @@
 #pragma once
-#include <fstream>
-#include <sstream>
-#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <GL/glew.h>
 
+/*
+A program linked from a vertex and a fragment shader file.
+Once linked, the program is saved as a driver binary in cacheDirectory,
+named by a hash of both sources and of the driver. A later start with the
+same sources and driver loads that binary instead of compiling. A binary
+the driver turns down, after a driver update say, is compiled from source
+again and replaced.
+Errors go to stdout, and valid() tells whether the program can be used
+*/
 class Shader {
 public:
 	GLuint Program;
 
-	Shader(const GLchar* vertexPath, const GLchar* fragmentPath) {
-		std::string vertexCode;
-		std::string fragmentCode;
-		std::ifstream vShaderFile;
-		std::ifstream fShaderFile;
+	// where the binaries are kept, created when first needed
+	static std::string cacheDirectory;
 
-		vShaderFile.exceptions(std::ifstream::badbit);
-		fShaderFile.exceptions(std::ifstream::badbit);
+	/*
+	Without wait the program is only started. With KHR_parallel_shader_compile
+	the driver builds it on threads of its own, so programs started one after
+	another build side by side while the caller does other work.
+	ready() tells without blocking when a program is built, and finish() waits for it
+	*/
+	Shader(const GLchar* vertexPath, const GLchar* fragmentPath, bool wait = true);
 
-		try {
-			vShaderFile.open(vertexPath);
-			fShaderFile.open(fragmentPath);
-			std::stringstream vShaderStream, fShaderStream;
+	bool ready() const;
+	bool finish();
 
-			vShaderStream << vShaderFile.rdbuf();
-			fShaderStream << fShaderFile.rdbuf();
+	// read the files again and rebuild if they changed; FALSE, keeping the program there was, if the new one doesn't link
+	bool reload();
 
-			vShaderFile.close();
-			fShaderFile.close();
+	// location of a uniform of the finished program, asked of the driver once per program
+	GLint uniform(const GLchar *name);
 
-			vertexCode = vShaderStream.str();
-			fragmentCode = fShaderStream.str();
-		}
-		catch (std::ifstream::failure e) {
-			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
-		}
-		auto vShaderCode = vertexCode.c_str();
-		auto fShaderCode = fragmentCode.c_str();
+	bool valid() const { return linked; }
+	bool cached() const { return fromCache; }
 
-		GLuint vertex, fragment;
-		GLint success;
-		GLchar infoLog[512];
-
-		vertex = glCreateShader(GL_VERTEX_SHADER);
-		glShaderSource(vertex, 1, &vShaderCode, nullptr);
-		glCompileShader(vertex);
-
-		glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-		if (!success) {
-			glGetShaderInfoLog(vertex, 512, nullptr, infoLog);
-			std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-		}
-
-		fragment = glCreateShader(GL_FRAGMENT_SHADER);
-		glShaderSource(fragment, 1, &fShaderCode, nullptr);
-		glCompileShader(fragment);
-
-		glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-		if (!success) {
-			glGetShaderInfoLog(fragment, 512, nullptr, infoLog);
-			std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
-		}
+	void Use() const { glUseProgram(Program); }
+	~Shader() {}
 
-		Program = glCreateProgram();
-		glAttachShader(Program, vertex);
-		glAttachShader(Program, fragment);
-		glLinkProgram(Program);
+private:
+	std::string vertexPath, fragmentPath;
+	std::string vertexCode, fragmentCode;
+	unsigned long long hash;
 
-		glGetProgramiv(Program, GL_LINK_STATUS, &success);
-		if (!success) {
-			glGetProgramInfoLog(Program, 512, nullptr, infoLog);
-			std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
-		}
+	GLuint vertex, fragment; // only while a program built from source isn't finished
+	bool pending, linked, fromCache;
 
-		glDeleteShader(vertex);
-		glDeleteShader(fragment);
+	// a program has a handful of uniforms, so a list is quicker to search than a map
+	std::vector<std::pair<std::string, GLint>> uniforms;
 
-	}
-	void Use() const { glUseProgram(Program); }
-	~Shader() {}
+	bool read();
+	void start();
+	bool load();
+	void save() const;
+	std::string cachePath() const;
 };
@@ -0,0 +1,734 @@
+#include "triangulate.h"
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <limits>
+
+// half a unit in the last place of 1.0, the most a rounding is relatively off by
+static const double HALF_ULP = DBL_EPSILON / 2.0;
+
+const double Triangulate::ORIENTATION_BOUND = (3.0 + 16.0 * HALF_ULP) * HALF_ULP;
+const double Triangulate::IN_CIRCLE_BOUND = (10.0 + 96.0 * HALF_ULP) * HALF_ULP;
+
+/*
+Arithmetic without rounding, after Shewchuk's robust predicates.
+A number is an expansion: doubles that don't overlap, smallest first, whose
+sum is the number exactly. Sums and products of doubles are split into the
+rounded result and the error rounding left out, so they can be carried as
+expansions, and the sign of an expansion is the sign of its last component
+*/
+static const double SPLITTER = 134217729.0; // 2^27 + 1, splits a double in two halves of 26 bits
+
+// a + b as x + y, x the rounded sum; |a| >= |b|
+static inline void fastTwoSum(double a, double b, double &x, double &y) {
+	x = a + b;
+	y = b - (x - a);
+}
+
+static inline void twoSum(double a, double b, double &x, double &y) {
+	x = a + b;
+	auto bVirtual = x - a;
+	auto aVirtual = x - bVirtual;
+	y = (a - aVirtual) + (b - bVirtual);
+}
+
+static inline void split(double a, double &high, double &low) {
+	auto c = SPLITTER * a;
+	high = c - (c - a);
+	low = a - high;
+}
+
+static inline void twoProduct(double a, double b, double &x, double &y) {
+	double aHigh, aLow, bHigh, bLow;
+	x = a * b;
+	split(a, aHigh, aLow);
+	split(b, bHigh, bLow);
+	y = aLow * bLow - (((x - aHigh * bHigh) - aLow * bHigh) - aHigh * bLow);
+}
+
+// a - b exactly, in h; return its length
+static int difference(double a, double b, double *h) {
+	double x, y;
+	twoSum(a, -b, x, y);
+
+	int length = 0;
+	if (y != 0.0)
+		h[length++] = y;
+	h[length++] = x;
+	return length;
+}
+
+// e + f in h, which doesn't overlap either; return its length
+static int sum(const double *e, int eLength, const double *f, int fLength, double *h) {
+	double q, next, error;
+	int i = 0, j = 0, length = 0;
+
+	// the components of both merged by magnitude, the running sum carried in q
+	auto smaller = [&]() { return j == fLength || (i < eLength && std::fabs(e[i]) < std::fabs(f[j])); };
+
+	q = smaller() ? e[i++] : f[j++];
+	if (i < eLength && j < fLength) {
+		fastTwoSum(smaller() ? e[i++] : f[j++], q, next, error);
+		q = next;
+		if (error != 0.0)
+			h[length++] = error;
+	}
+
+	while (i < eLength || j < fLength) {
+		twoSum(q, smaller() ? e[i++] : f[j++], next, error);
+		q = next;
+		if (error != 0.0)
+			h[length++] = error;
+	}
+
+	if (q != 0.0 || length == 0)
+		h[length++] = q;
+	return length;
+}
+
+// e * b in h; return its length
+static int scale(const double *e, int eLength, double b, double *h) {
+	double q, product, productError, next, error;
+	int length = 0;
+
+	twoProduct(e[0], b, q, error);
+	if (error != 0.0)
+		h[length++] = error;
+
+	for (int i = 1; i < eLength; i++) {
+		twoProduct(e[i], b, product, productError);
+		twoSum(q, productError, next, error);
+		if (error != 0.0)
+			h[length++] = error;
+		fastTwoSum(product, next, q, error);
+		if (error != 0.0)
+			h[length++] = error;
+	}
+
+	if (q != 0.0 || length == 0)
+		h[length++] = q;
+	return length;
+}
+
+// e * f in h, which must hold 2 * eLength * fLength; scratch holds as much again
+static int product(const double *e, int eLength, const double *f, int fLength, double *h, double *scratch) {
+	double part[64];
+	auto length = scale(e, eLength, f[0], h);
+
+	for (int i = 1; i < fLength; i++) {
+		auto partLength = scale(e, eLength, f[i], part);
+		length = sum(h, length, part, partLength, scratch);
+		std::copy(scratch, scratch + length, h);
+	}
+	return length;
+}
+
+static double estimate(const double *e, int length) {
+	auto value = 0.0;
+	for (int i = 0; i < length; i++)
+		value += e[i];
+	return value;
+}
+
+double Triangulate::exactOrientation(const XYZ &a, const XYZ &b, const XYZ &c) {
+	double bx[2], by[2], cx[2], cy[2];
+	double left[8], right[8], scratch[8], det[16];
+
+	auto bxLength = difference(b.x, a.x, bx), byLength = difference(b.y, a.y, by);
+	auto cxLength = difference(c.x, a.x, cx), cyLength = difference(c.y, a.y, cy);
+
+	auto leftLength = product(bx, bxLength, cy, cyLength, left, scratch);
+	auto rightLength = product(by, byLength, cx, cxLength, right, scratch);
+	for (int i = 0; i < rightLength; i++)
+		right[i] = -right[i];
+
+	return estimate(det, sum(left, leftLength, right, rightLength, det));
+}
+
+double Triangulate::exactInCircle(const XYZ &a, const XYZ &b, const XYZ &c, const XYZ &d) {
+	double dx[3][2], dy[3][2];
+	int dxLength[3], dyLength[3];
+	const XYZ *corner[3] = { &a, &b, &c };
+
+	for (int k = 0; k < 3; k++) {
+		dxLength[k] = difference(corner[k]->x, d.x, dx[k]);
+		dyLength[k] = difference(corner[k]->y, d.y, dy[k]);
+	}
+
+	/*
+	the sum over the corners of the squared distance to d times the
+	cross product of the other two, all relative to d
+	*/
+	double det[1536], next[1536], term[512], scratch[512];
+	int detLength = 0;
+
+	for (int k = 0; k < 3; k++) {
+		int k1 = (k + 1) % 3, k2 = (k + 2) % 3;
+		double xx[8], yy[8], xy[8], yx[8], lift[16], cross[16], partScratch[8];
+
+		auto xxLength = product(dx[k], dxLength[k], dx[k], dxLength[k], xx, partScratch);
+		auto yyLength = product(dy[k], dyLength[k], dy[k], dyLength[k], yy, partScratch);
+		auto liftLength = sum(xx, xxLength, yy, yyLength, lift);
+
+		auto xyLength = product(dx[k1], dxLength[k1], dy[k2], dyLength[k2], xy, partScratch);
+		auto yxLength = product(dy[k1], dyLength[k1], dx[k2], dxLength[k2], yx, partScratch);
+		for (int i = 0; i < yxLength; i++)
+			yx[i] = -yx[i];
+		auto crossLength = sum(xy, xyLength, yx, yxLength, cross);
+
+		auto termLength = product(lift, liftLength, cross, crossLength, term, scratch);
+		if (detLength == 0) {
+			std::copy(term, term + termLength, det);
+			detLength = termLength;
+		} else {
+			detLength = sum(det, detLength, term, termLength, next);
+			std::copy(next, next + detLength, det);
+		}
+	}
+
+	return estimate(det, detLength);
+}
+
+int Triangulate::triangulate(int pointNumb, const XYZ *xyz, Triangle *triangles) {
+	thread_local Triangulate engine;
+	thread_local std::vector<Triangle> result;
+
+	auto triangleNumber = engine.run(xyz, pointNumb, result);
+	std::copy(result.begin(), result.end(), triangles);
+
+	return triangleNumber;
+}
+
+int Triangulate::triangulate(const std::vector<XYZ> &points, std::vector<Triangle> &triangles) {
+	return run(points.data(), static_cast<int>(points.size()), triangles);
+}
+
+void Triangulate::reserve(int pointNumb) {
+	// the open front and its edges stay far below these in practice
+	vertices.reserve(pointNumb);
+	order.reserve(pointNumb);
+	open.reserve(2 * pointNumb + 1);
+	xCircle.reserve(2 * pointNumb + 1);
+	yCircle.reserve(2 * pointNumb + 1);
+	rInner.reserve(2 * pointNumb + 1);
+	rOuter.reserve(2 * pointNumb + 1);
+	inside.reserve(2 * pointNumb + 1);
+	complete.reserve(2 * pointNumb + 1);
+}
+
+/*
+append a triangle to the open list together with its cached circumcircle:
+the centre, and the squared radius shrunk and grown by as much as rounding
+can be off. The error of the centre is bounded from the terms that went
+into it; moving the centre by d changes the squared distance of a point p
+to it, less the squared radius, by at most 2 d |p - a| for a corner a,
+which is below d / r times the squared distance plus three squared radii.
+So a point closer to the centre than the inner radius is inside for sure,
+and one further than the outer radius is outside.
+A ghost triangle, or one so flat that its centre can't be trusted at all,
+gets no inner radius and an infinite outer one, and every point is tested
+against it exactly
+*/
+void Triangulate::addOpen(int p1, int p2, int p3) {
+	Triangle triangle;
+	auto xC = 0.0, yC = 0.0, rIn = -1.0, rOut = std::numeric_limits<double>::infinity();
+
+	triangle.p1 = p1;
+	triangle.p2 = p2;
+	triangle.p3 = p3;
+
+	if (p1 != ghost && p2 != ghost && p3 != ghost) {
+		auto &a = vertices[p1], &b = vertices[p2], &c = vertices[p3];
+		auto bx = b.x - a.x, by = b.y - a.y;
+		auto cx = c.x - a.x, cy = c.y - a.y;
+		auto cross = bx * cy - by * cx;
+		auto crossError = 8.0 * HALF_ULP * (std::fabs(bx * cy) + std::fabs(by * cx));
+
+		if (std::fabs(cross) > 2.0 * crossError) {
+			auto b2 = bx * bx + by * by, c2 = cx * cx + cy * cy;
+			auto xN = cy * b2 - by * c2, yN = bx * c2 - cx * b2;
+			auto xError = 8.0 * HALF_ULP * (std::fabs(cy) * b2 + std::fabs(by) * c2);
+			auto yError = 8.0 * HALF_ULP * (std::fabs(bx) * c2 + std::fabs(cx) * b2);
+
+			xC = a.x + xN / (2.0 * cross);
+			yC = a.y + yN / (2.0 * cross);
+
+			// first order in the errors, doubled for the rest; then what adding a rounded off
+			auto centreError = 2.0 * ((xError + yError) + (std::fabs(xN) + std::fabs(yN)) * crossError / std::fabs(cross)) / (2.0 * std::fabs(cross))
+				+ HALF_ULP * (std::fabs(xC) + std::fabs(yC));
+
+			// k relative to the squared distance plus three squared radii, with the rounding of the test itself
+			auto rsqr = (a.x - xC) * (a.x - xC) + (a.y - yC) * (a.y - yC);
+			auto k = rsqr > 0.0 ? centreError / std::sqrt(rsqr) + 16.0 * HALF_ULP : 1.0;
+
+			if (k < 1.0 / 3.0)
+				rIn = rsqr * (1.0 - 3.0 * k) / (1.0 + k);
+			if (k < 1.0)
+				rOut = rsqr * (1.0 + 3.0 * k) / (1.0 - k);
+		}
+	}
+
+	open.push_back(triangle);
+	xCircle.push_back(xC);
+	yCircle.push_back(yC);
+	rInner.push_back(rIn);
+	rOuter.push_back(rOut);
+}
+
+/*
+TRUE if the point breaks the open triangle, by exact tests.
+A clockwise triangle is broken by a point strictly inside its circumcircle.
+A ghost triangle (a, b, ghost) stands for the outside of the hull edge a-b:
+it is broken by a point strictly on that side, or on the edge's line between a and b
+*/
+bool Triangulate::conflict(const Triangle &triangle, int point) const {
+	auto &p = vertices[point];
+
+	if (triangle.p1 != ghost && triangle.p2 != ghost && triangle.p3 != ghost)
+		return inCircle(vertices[triangle.p1], vertices[triangle.p3], vertices[triangle.p2], p) > 0.0;
+
+	int a = triangle.p1, b = triangle.p2;
+	if (a == ghost) {
+		a = triangle.p2;
+		b = triangle.p3;
+	} else if (b == ghost) {
+		a = triangle.p3;
+		b = triangle.p1;
+	}
+
+	auto side = orientation(vertices[a], vertices[b], p);
+	if (side != 0.0)
+		return side < 0.0;
+
+	// on the line: between a and b in x, then y, as on the line both order them alike
+	auto before = [](const XYZ &u, const XYZ &v) { return u.x < v.x || (u.x == v.x && u.y < v.y); };
+	return (before(vertices[a], p) && before(p, vertices[b])) || (before(vertices[b], p) && before(p, vertices[a]));
+}
+
+int Triangulate::run(const XYZ *xyz, int pointNumb, std::vector<Triangle> &triangles) {
+	double 	xPoint, yPoint;
+
+	triangles.clear();
+	open.clear();
+	xCircle.clear();
+	yCircle.clear();
+	rInner.clear();
+	rOuter.clear();
+
+	if (pointNumb < 3)
+		return 0;
+
+	// the sweep below needs the vertices sorted by x, y breaks ties so that coincident points end up together
+	order.resize(pointNumb);
+	for (int i = 0; i < pointNumb; i++)
+		order[i] = i;
+
+	auto byX = [xyz](int i, int j) { return xyz[i].x < xyz[j].x || (xyz[i].x == xyz[j].x && xyz[i].y < xyz[j].y); };
+	if (!std::is_sorted(order.begin(), order.end(), byX))
+		std::sort(order.begin(), order.end(), byX);
+
+	vertices.resize(pointNumb);
+	for (int i = 0; i < pointNumb; i++)
+		vertices[i] = xyz[order[i]];
+
+	/*
+	Instead of a supertriangle, the hull is closed by ghost triangles that
+	share one vertex at infinity, numbered after the points. A supertriangle
+	is only so far away, and hull triangles with a circumcircle reaching it
+	were lost; a ghost triangle is broken exactly by the points outside its
+	hull edge. Each point comes after all the others in x, so it is always
+	outside the hull and some ghost triangles are in its cavity.
+	Until three points are off a line there are no triangles: the points
+	so far make a chain with a ghost triangle on either side of each link
+	*/
+	ghost = pointNumb;
+	auto chain = true;
+	int last = 0;
+
+	// include each point one at a time into the existing mesh
+	for (int i = 1; i < pointNumb; i++) {
+
+		xPoint = vertices[i].x;
+		yPoint = vertices[i].y;
+		edges.clear();
+
+		// a point coincident with the previous one is already in the mesh
+		if (xPoint == vertices[i - 1].x && yPoint == vertices[i - 1].y)
+			continue;
+
+		if (chain && (open.empty() || orientation(vertices[0], vertices[last], vertices[i]) == 0.0)) {
+			addOpen(last, i, ghost);
+			addOpen(i, last, ghost);
+			last = i;
+			continue;
+		}
+		chain = false;
+
+		auto openNumber = static_cast<int>(open.size());
+		inside.resize(openNumber);
+		complete.resize(openNumber);
+
+		/*
+		Test the point against every open circumcircle at once.
+		A triangle whose circumcircle lies entirely to the left of the
+		point can't be broken by any later point, so it is complete.
+		Between the inner and the outer radius the answer is left open (2),
+		and such triangles are tested exactly below
+		*/
+		const double *xC = xCircle.data();
+		const double *yC = yCircle.data();
+		const double *rIn = rInner.data();
+		const double *rOut = rOuter.data();
+		char *in = inside.data();
+		char *done = complete.data();
+
+		for (int j = 0; j < openNumber; j++) {
+			auto xD = xPoint - xC[j];
+			auto yD = yPoint - yC[j];
+			auto dsqr = xD * xD + yD * yD;
+			in[j] = 2 * (dsqr <= rOut[j]) - (dsqr < rIn[j]);
+			done[j] = xD > 0.0 && xD * xD > rOut[j];
+		}
+
+		/*
+		Set up the edge buffer.
+		If the point (xP, yP) lies inside the circumcircle then the
+		three edges of that triangle are added to the edge buffer
+		and that triangle is removed.
+		Complete triangles are moved to the result list.
+		*/
+		int openKept = 0;
+		for (int j = 0; j < openNumber; j++) {
+			if (in[j] == 2 ? conflict(open[j], i) : in[j]) {
+				Edge edge;
+
+				edge.p1 = open[j].p1;
+				edge.p2 = open[j].p2;
+				edges.push_back(edge);
+				edge.p1 = open[j].p2;
+				edge.p2 = open[j].p3;
+				edges.push_back(edge);
+				edge.p1 = open[j].p3;
+				edge.p2 = open[j].p1;
+				edges.push_back(edge);
+				continue;
+			}
+
+			if (done[j]) {
+				triangles.push_back(open[j]);
+				continue;
+			}
+
+			open[openKept] = open[j];
+			xCircle[openKept] = xCircle[j];
+			yCircle[openKept] = yCircle[j];
+			rInner[openKept] = rInner[j];
+			rOuter[openKept] = rOuter[j];
+			openKept++;
+		}
+
+		open.resize(openKept);
+		xCircle.resize(openKept);
+		yCircle.resize(openKept);
+		rInner.resize(openKept);
+		rOuter.resize(openKept);
+
+		auto edgeNumber = static_cast<int>(edges.size());
+
+
+		// tag multiple edges
+		for (int j = 0; j < edgeNumber - 1; j++) {
+			for (int k = j + 1; k < edgeNumber; k++) {
+				if ((edges[j].p1 == edges[k].p2) && (edges[j].p2 == edges[k].p1)) {
+					edges[j].p1 = -1;
+					edges[j].p2 = -1;
+					edges[k].p1 = -1;
+					edges[k].p2 = -1;
+				}
+			}
+		}
+
+		/*
+		Form new triangles for the current point
+		skip any tagged edges.
+		all edges are arranged in clockwise order.
+		An edge to the ghost vertex makes a ghost triangle.
+		*/
+		for (int j = 0; j < edgeNumber; j++) {
+			if (edges[j].p1 == -1 || edges[j].p2 == -1)
+				continue;
+
+			addOpen(edges[j].p1, edges[j].p2, i);
+		}
+
+		/*
+		i + 1 points make at most 2 * (i + 1) - 2 triangles, ghosts included.
+		With exact tests the cavity is always star shaped and this never
+		happens, but should it break, give up before the overlapping
+		triangles multiply
+		*/
+		if (open.size() + triangles.size() > 2 * static_cast<size_t>(i + 1)) {
+			open.clear();
+			triangles.clear();
+			return -1;
+		}
+	}
+
+	// whatever is still open is final as well
+	triangles.insert(triangles.end(), open.begin(), open.end());
+
+
+	/*
+	Remove the ghost triangles
+	These are triangles which have a vertex number of pointNumb
+	and give the rest the caller's indices
+	*/
+	int triangleNumber = 0;
+	for (auto iter = triangles.begin(); iter != triangles.end(); ++iter) {
+		if (iter->p1 == ghost || iter->p2 == ghost || iter->p3 == ghost)
+			continue;
+
+		triangles[triangleNumber].p1 = order[iter->p1];
+		triangles[triangleNumber].p2 = order[iter->p2];
+		triangles[triangleNumber].p3 = order[iter->p3];
+		triangleNumber++;
+	}
+	triangles.resize(triangleNumber);
+
+	return triangleNumber;
+}
+
+// directed edge p1 -> p2 of a triangle, "opposite" is its third vertex
+struct HalfEdge {
+	uint64_t key;
+	int opposite;
+
+	bool operator<(const HalfEdge &other) const { return key < other.key; }
+};
+
+static uint64_t edgeKey(int p1, int p2) {
+	return (static_cast<uint64_t>(p1) << 32) | static_cast<uint32_t>(p2);
+}
+
+void Triangulate::neighbours(const Triangle *triangles, int triangleNumber, std::vector<int> &result) {
+	// every directed edge in an open addressing table with the triangle it belongs to
+	size_t slots = 16;
+	while (slots < 6 * static_cast<size_t>(triangleNumber))
+		slots *= 2;
+
+	std::vector<uint64_t> keys(slots, ~0ull);
+	std::vector<int> owner(slots);
+
+	auto key = [](int a, int b) { return static_cast<uint64_t>(static_cast<uint32_t>(a)) << 32 | static_cast<uint32_t>(b); };
+	auto find = [&](uint64_t k) {
+		auto s = static_cast<size_t>((k * 0x9E3779B97F4A7C15ull) >> 20) & (slots - 1);
+		while (keys[s] != ~0ull && keys[s] != k)
+			s = (s + 1) & (slots - 1);
+		return s;
+	};
+
+	for (int t = 0; t < triangleNumber; t++) {
+		int corner[3] = { triangles[t].p1, triangles[t].p2, triangles[t].p3 };
+
+		for (int k = 0; k < 3; k++) {
+			auto k2 = key(corner[k], corner[(k + 1) % 3]);
+			auto s = find(k2);
+			keys[s] = k2;
+			owner[s] = t;
+		}
+	}
+
+	// the triangles turn the same way, so the one across an edge has it the other way round
+	result.resize(3 * static_cast<size_t>(triangleNumber));
+
+	for (int t = 0; t < triangleNumber; t++) {
+		int corner[3] = { triangles[t].p1, triangles[t].p2, triangles[t].p3 };
+
+		for (int k = 0; k < 3; k++) {
+			auto s = find(key(corner[(k + 1) % 3], corner[k]));
+			result[3 * t + k] = keys[s] == ~0ull ? -1 : owner[s];
+		}
+	}
+}
+
+bool Triangulate::verify(int pointNumb, const XYZ *xyz, const Triangle *triangles, int triangleNumber) {
+	long errors = 0;
+	double winding = 0.0;
+
+	if (triangleNumber < 0) {
+		std::cout << "verify: triangulation failed" << std::endl;
+		return false;
+	}
+
+	std::vector<HalfEdge> halfEdges;
+	std::vector<int> used(pointNumb, 0);
+
+	halfEdges.reserve(3 * triangleNumber);
+
+	// every triangle must be proper and wound the same way as the first one
+	for (int i = 0; i < triangleNumber; i++) {
+		int p[3] = { triangles[i].p1, triangles[i].p2, triangles[i].p3 };
+
+		if (p[0] < 0 || p[1] < 0 || p[2] < 0 || p[0] >= pointNumb || p[1] >= pointNumb || p[2] >= pointNumb) {
+			std::cout << "verify: triangle " << i << " has a vertex out of range" << std::endl;
+			return false;
+		}
+
+		auto area = orientation(xyz[p[0]], xyz[p[1]], xyz[p[2]]);
+		if (area == 0.0) {
+			std::cout << "verify: triangle " << i << " is degenerate" << std::endl;
+			errors++;
+			continue;
+		}
+
+		if (winding == 0.0)
+			winding = area > 0.0 ? 1.0 : -1.0;
+
+		if (area * winding < 0.0) {
+			std::cout << "verify: triangle " << i << " has the opposite winding" << std::endl;
+			errors++;
+		}
+
+		for (int k = 0; k < 3; k++) {
+			used[p[k]] = 1;
+			halfEdges.push_back({ edgeKey(p[k], p[(k + 1) % 3]), p[(k + 2) % 3] });
+		}
+	}
+
+	std::sort(halfEdges.begin(), halfEdges.end());
+
+	std::vector<int> boundaryNext(pointNumb, -1);
+	int boundaryNumber = 0;
+	long checked = 0;
+
+	for (auto iter = halfEdges.begin(); iter != halfEdges.end(); ++iter) {
+		int p1 = static_cast<int>(iter->key >> 32), p2 = static_cast<int>(iter->key & 0xffffffffu);
+
+		if (iter + 1 != halfEdges.end() && (iter + 1)->key == iter->key) {
+			std::cout << "verify: edge " << p1 << "-" << p2 << " is used twice in the same direction" << std::endl;
+			errors++;
+			continue;
+		}
+
+		HalfEdge twin = { edgeKey(p2, p1), 0 };
+		auto found = std::lower_bound(halfEdges.begin(), halfEdges.end(), twin);
+
+		if (found == halfEdges.end() || found->key != twin.key) {
+			if (boundaryNext[p1] != -1) {
+				std::cout << "verify: boundary is not a simple polygon at vertex " << p1 << std::endl;
+				errors++;
+			}
+			boundaryNext[p1] = p2;
+			boundaryNumber++;
+			continue;
+		}
+
+		if (p1 > p2)
+			continue;
+
+		// the opposite vertex of the neighbour must not be inside this triangle's circumcircle
+		auto &a = xyz[p1];
+		auto &b = xyz[p2];
+		auto &c = xyz[iter->opposite];
+		auto &d = xyz[found->opposite];
+
+		// both signs are exact, so cocircular points pass and nothing else is let off
+		auto det = inCircle(a, b, c, d) * (orientation(a, b, c) > 0.0 ? 1.0 : -1.0);
+
+		if (det > 0.0) {
+			std::cout << "verify: edge " << p1 << "-" << p2 << " is not locally Delaunay" << std::endl;
+			errors++;
+		}
+		checked++;
+	}
+
+	// the boundary must be one convex loop
+	int start = -1;
+	for (int i = 0; i < pointNumb && start == -1; i++)
+		if (boundaryNext[i] != -1)
+			start = i;
+
+	if (start != -1) {
+		int loop = 0;
+		int current = start;
+
+		do {
+			int next = boundaryNext[current];
+			int after = next == -1 ? -1 : boundaryNext[next];
+
+			if (after == -1) {
+				std::cout << "verify: boundary is broken at vertex " << current << std::endl;
+				errors++;
+				break;
+			}
+			if (orientation(xyz[current], xyz[next], xyz[after]) * winding < 0.0) {
+				std::cout << "verify: boundary is not convex at vertex " << next << std::endl;
+				errors++;
+			}
+
+			current = next;
+			loop++;
+		} while (current != start && loop <= boundaryNumber);
+
+		if (loop != boundaryNumber) {
+			std::cout << "verify: boundary has " << boundaryNumber << " edges but its loop has " << loop << std::endl;
+			errors++;
+		}
+	}
+
+	// every distinct point must be a vertex, coincident ones may be left out
+	std::vector<int> order;
+	for (int i = 0; i < pointNumb; i++)
+		order.push_back(i);
+
+	std::sort(order.begin(), order.end(), [xyz](int i, int j) {
+		return xyz[i].x < xyz[j].x || (xyz[i].x == xyz[j].x && xyz[i].y < xyz[j].y);
+	});
+
+	int vertexNumber = 0;
+	for (int i = 0; i < pointNumb; i++) {
+		int first = i;
+		bool covered = false;
+
+		while (i + 1 < pointNumb && xyz[order[i + 1]].x == xyz[order[first]].x && xyz[order[i + 1]].y == xyz[order[first]].y)
+			i++;
+
+		for (int k = first; k <= i; k++)
+			if (used[order[k]]) {
+				covered = true;
+				vertexNumber++;
+			}
+
+		if (!covered && triangleNumber > 0) {
+			std::cout << "verify: point " << order[first] << " is not a vertex of any triangle" << std::endl;
+			errors++;
+		}
+	}
+
+	// Euler's formula for a triangulated convex polygon with interior points
+	if (triangleNumber > 0 && triangleNumber != 2 * vertexNumber - 2 - boundaryNumber) {
+		std::cout << "verify: " << triangleNumber << " triangles, expected " << 2 * vertexNumber - 2 - boundaryNumber << std::endl;
+		errors++;
+	}
+
+	// no triangles is right only when there aren't three points off a line
+	if (triangleNumber == 0 && pointNumb >= 3) {
+		int first = order[0], second = -1;
+
+		for (int i = 1; i < pointNumb && second == -1; i++)
+			if (xyz[order[i]].x != xyz[first].x || xyz[order[i]].y != xyz[first].y)
+				second = order[i];
+
+		for (int i = 0; i < pointNumb && second != -1; i++)
+			if (orientation(xyz[first], xyz[second], xyz[i]) != 0.0) {
+				std::cout << "verify: no triangles, but point " << i << " is off the line through the others" << std::endl;
+				errors++;
+				break;
+			}
+	}
+
+	std::cout << "verify: " << triangleNumber << " triangles, " << checked << " inner edges checked, "
+		<< errors << " problems" << std::endl;
+
+	return errors == 0;
+}
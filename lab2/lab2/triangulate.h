@@ -0,0 +1,154 @@
+#pragma once
+#include <iostream>
+#include <cmath>
+#include <vector>
+
+class Triangle {
+public:
+	int p1, p2, p3;
+
+	Triangle() { }
+};
+
+class Edge {
+public:
+	int p1, p2;
+	Edge() { p1 = -1; p2 = -1; }
+};
+
+class XYZ {
+public:
+	double x, y, z;
+
+	XYZ() { }
+
+	XYZ(double _x, double _y, double _z) : x(_x), y(_y), z(_z)
+	{}
+};
+
+class Triangulate {
+
+public:
+	/*
+	twice the signed area of the triangle (a, b, c)
+	positive if the points are in counterclockwise order
+	The sign is exact: when rounding could have flipped it, the area is
+	worked out again without rounding, so zero means exactly on a line
+	*/
+	static double orientation(const XYZ &a, const XYZ &b, const XYZ &c) {
+		auto left = (b.x - a.x) * (c.y - a.y), right = (b.y - a.y) * (c.x - a.x);
+		auto det = left - right;
+
+		if (std::fabs(det) >= ORIENTATION_BOUND * (std::fabs(left) + std::fabs(right)))
+			return det;
+		return exactOrientation(a, b, c);
+	}
+
+	/*
+	circumcentre of the triangle (a, b, c), worked out from a so that it keeps
+	its precision on small triangles far from the origin
+	return FALSE if the points are on a line
+	*/
+	static bool circumCentre(const XYZ &a, const XYZ &b, const XYZ &c, XYZ &centre) {
+		auto bx = b.x - a.x, by = b.y - a.y;
+		auto cx = c.x - a.x, cy = c.y - a.y;
+		auto d = 2.0 * (bx * cy - by * cx);
+
+		if (d == 0.0)
+			return false;
+
+		auto b2 = bx * bx + by * by, c2 = cx * cx + cy * cy;
+		centre = XYZ(a.x + (cy * b2 - by * c2) / d, a.y + (bx * c2 - cx * b2) / d, 0.0);
+		return true;
+	}
+
+	/*
+	positive if d is inside the circumcircle of the counterclockwise
+	triangle (a, b, c), negative if outside and zero if all four are cocircular
+	The sign is exact, as with orientation()
+	*/
+	static double inCircle(const XYZ &a, const XYZ &b, const XYZ &c, const XYZ &d) {
+		auto adx = a.x - d.x, ady = a.y - d.y;
+		auto bdx = b.x - d.x, bdy = b.y - d.y;
+		auto cdx = c.x - d.x, cdy = c.y - d.y;
+		auto aLift = adx * adx + ady * ady, bLift = bdx * bdx + bdy * bdy, cLift = cdx * cdx + cdy * cdy;
+
+		auto det = aLift * (bdx * cdy - bdy * cdx) + bLift * (cdx * ady - cdy * adx) + cLift * (adx * bdy - ady * bdx);
+		auto permanent = aLift * (std::fabs(bdx * cdy) + std::fabs(bdy * cdx)) + bLift * (std::fabs(cdx * ady) + std::fabs(cdy * adx))
+			+ cLift * (std::fabs(adx * bdy) + std::fabs(ady * bdx));
+
+		if (std::fabs(det) > IN_CIRCLE_BOUND * permanent)
+			return det;
+		return exactInCircle(a, b, c, d);
+	}
+
+	/*
+	Check that the triangles are a Delaunay triangulation of the pointNumb vertices in xyz:
+	one winding for all triangles, every edge shared by at most two of them,
+	a convex boundary, every distinct point used, and no vertex inside the
+	circumcircle of the triangle on the other side of an edge.
+	No triangles at all pass only if the points are all on one line.
+	Problems are reported to stdout
+	*/
+	static bool verify(int pointNumb, const XYZ *xyz, const Triangle *triangles, int triangleNumber);
+
+	/*
+	The triangle across each edge: result[3 * i + k] is the neighbour of
+	triangle i across the edge from its corner k to the next one, -1 on the hull.
+	The triangles must all turn the same way, as both engines give them
+	*/
+	static void neighbours(const Triangle *triangles, int triangleNumber, std::vector<int> &result);
+
+	/*
+	Triangulation subroutine
+	Takes as input pointNumb vertices in array xyz, in any order
+	Coincident points are triangulated once
+	These triangles are arranged in a consistent clockwise order.
+	The triangle array "triangle" should be malloced to 3 * pointNumb
+	(the result never has more than 2 * pointNumb triangles)
+	Each thread keeps one Triangulate whose buffers are reused between calls
+	Return -1 if the triangulation breaks, which exact tests keep from happening
+	*/
+	static int triangulate(int pointNumb, const XYZ *xyz, Triangle *triangles);
+
+	/*
+	Triangulate points into triangles, which is cleared first
+	Neither triangles nor the internal buffers ever shrink, so once they have
+	grown to the batch size later batches are triangulated without allocating
+	*/
+	int triangulate(const std::vector<XYZ> &points, std::vector<Triangle> &triangles);
+
+	// size the buffers for batches of pointNumb points up front
+	void reserve(int pointNumb);
+
+private:
+	/*
+	The most rounding can be off by in the two determinants above, relative
+	to the sum of the magnitudes of their terms (Shewchuk's error bounds);
+	a result further from zero than this has the right sign as it is
+	*/
+	static const double ORIENTATION_BOUND, IN_CIRCLE_BOUND;
+
+	static double exactOrientation(const XYZ &a, const XYZ &b, const XYZ &c);
+	static double exactInCircle(const XYZ &a, const XYZ &b, const XYZ &c, const XYZ &d);
+
+	std::vector<XYZ> vertices; // the input sorted by x
+	std::vector<int> order; // input index of each vertex
+	int ghost; // the vertex at infinity, after the last one
+
+	/*
+	Triangles that may still be broken by a later point are kept apart from
+	the finished ones, with their circumcircles (centre and squared radius
+	less and plus its error) computed once at creation and stored as separate arrays.
+	This way the in-circle test is a plain loop over doubles,
+	and only the few points too close to a circle to tell are tested exactly.
+	*/
+	std::vector<Triangle> open;
+	std::vector<double> xCircle, yCircle, rInner, rOuter;
+	std::vector<char> inside, complete;
+	std::vector<Edge> edges;
+
+	int run(const XYZ *xyz, int pointNumb, std::vector<Triangle> &triangles);
+	void addOpen(int p1, int p2, int p3);
+	bool conflict(const Triangle &triangle, int point) const;
+};
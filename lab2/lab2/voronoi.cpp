@@ -0,0 +1,199 @@
+#include "voronoi.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+
+// a cell has one vertex per triangle round its point, three more on the hull and one more for each side of the box
+static const int CELL_EXTRA = 7;
+
+// keep the part of a convex polygon where side, a linear function, is not negative
+template <typename Side>
+static void clip(std::vector<XYZ> &polygon, std::vector<XYZ> &result, Side side) {
+	result.clear();
+
+	for (size_t i = 0; i < polygon.size(); i++) {
+		auto &a = polygon[i];
+		auto &b = polygon[(i + 1) % polygon.size()];
+		auto sideA = side(a), sideB = side(b);
+
+		if (sideA >= 0.0)
+			result.push_back(a);
+
+		if ((sideA >= 0.0) != (sideB >= 0.0)) {
+			auto t = sideA / (sideA - sideB);
+			result.push_back(XYZ(a.x + t * (b.x - a.x), a.y + t * (b.y - a.y), 0.0));
+		}
+	}
+
+	polygon.swap(result);
+}
+
+// unit normal of the edge from a to b, on the side away from inner
+static XYZ outward(const XYZ &a, const XYZ &b, const XYZ &inner) {
+	auto x = b.y - a.y, y = a.x - b.x;
+	auto length = std::sqrt(x * x + y * y);
+
+	if ((inner.x - a.x) * x + (inner.y - a.y) * y > 0.0)
+		length = -length;
+
+	return length == 0.0 ? XYZ(0.0, 0.0, 0.0) : XYZ(x / length, y / length, 0.0);
+}
+
+VoronoiDiagram::VoronoiDiagram(int pointNumb, const XYZ *xyz, const Triangle *triangles, int triangleNumber,
+	double xMin, double yMin, double xMax, double yMax, int threadNumber)
+	: graphFirst(pointNumb + 1, 0), polygonFirst(pointNumb + 1, 0) {
+
+	if (triangleNumber <= 0)
+		return;
+
+	std::vector<int> adjacent;
+	Triangulate::neighbours(triangles, triangleNumber, adjacent);
+
+	auto winding = 1.0;
+	for (int t = 0; t < triangleNumber; t++) {
+		auto area = Triangulate::orientation(xyz[triangles[t].p1], xyz[triangles[t].p2], xyz[triangles[t].p3]);
+		if (area != 0.0) {
+			winding = area > 0.0 ? 1.0 : -1.0;
+			break;
+		}
+	}
+
+	centres.resize(triangleNumber);
+
+	inParallel(triangleNumber, threadNumber, [&](size_t begin, size_t end) {
+		for (auto t = begin; t < end; t++) {
+			auto &a = xyz[triangles[t].p1], &b = xyz[triangles[t].p2], &c = xyz[triangles[t].p3];
+
+			// a flat triangle has no circumcentre, its centroid stands in
+			if (!Triangulate::circumCentre(a, b, c, centres[t]))
+				centres[t] = XYZ((a.x + b.x + c.x) / 3.0, (a.y + b.y + c.y) / 3.0, 0.0);
+		}
+	});
+
+	/*
+	A point has a neighbour for each triangle at it, and one more on the hull,
+	where it starts exactly one hull edge. Any of its triangles starts the walk
+	*/
+	std::vector<int> start(pointNumb, -1);
+
+	for (int t = 0; t < triangleNumber; t++) {
+		int corner[3] = { triangles[t].p1, triangles[t].p2, triangles[t].p3 };
+
+		for (int k = 0; k < 3; k++) {
+			graphFirst[corner[k] + 1] += adjacent[3 * t + k] < 0 ? 2 : 1;
+			start[corner[k]] = t;
+		}
+	}
+	for (int v = 0; v < pointNumb; v++)
+		graphFirst[v + 1] += graphFirst[v];
+
+	/*
+	Neighbouring triangles are mostly close in the array, so the points are
+	walked in the order of their triangles (a counting sort) rather than by index,
+	which keeps the triangles and circumcentres a walk reads in cache
+	*/
+	std::vector<int> order(pointNumb), bucket(triangleNumber + 2, 0);
+	for (int v = 0; v < pointNumb; v++)
+		bucket[start[v] + 2]++;
+	for (int t = 0; t <= triangleNumber; t++)
+		bucket[t + 1] += bucket[t];
+	for (int v = 0; v < pointNumb; v++)
+		order[bucket[start[v] + 1]++] = v;
+
+	graph.assign(graphFirst[pointNumb], -1);
+
+	// the cells are written with room to spare, then packed
+	std::vector<XYZ> spare(graphFirst[pointNumb] + static_cast<size_t>(CELL_EXTRA) * pointNumb);
+	std::vector<int> size(pointNumb, 0);
+
+	// a point far enough out on the rays of a hull cell is outside the box whatever the cell
+	auto xCentre = (xMin + xMax) / 2.0, yCentre = (yMin + yMax) / 2.0;
+	auto radius = std::sqrt((xMax - xMin) * (xMax - xMin) + (yMax - yMin) * (yMax - yMin)) / 2.0;
+	auto away = [&](const XYZ &point) { return std::sqrt((point.x - xCentre) * (point.x - xCentre) + (point.y - yCentre) * (point.y - yCentre)); };
+
+	inParallel(pointNumb, threadNumber, [&](size_t begin, size_t end) {
+		std::vector<XYZ> polygon, scratch;
+
+		for (auto i = begin; i < end; i++) {
+			auto v = order[i];
+			if (start[v] < 0)
+				continue;
+
+			auto cornerOf = [&](int t) { return triangles[t].p1 == v ? 0 : (triangles[t].p2 == v ? 1 : 2); };
+			auto corner = [&](int t, int k) { return k == 0 ? triangles[t].p1 : (k == 1 ? triangles[t].p2 : triangles[t].p3); };
+
+			/*
+			Crossing the edge from v to the next corner goes round v one way;
+			go the other way first to the hull, if v is on it, so that one walk
+			sees every triangle at v in order
+			*/
+			auto first = start[v];
+			for (auto steps = graphFirst[v + 1] - graphFirst[v]; steps > 0; steps--) {
+				auto back = adjacent[3 * first + (cornerOf(first) + 2) % 3];
+				if (back < 0 || back == start[v])
+					break;
+				first = back;
+			}
+
+			auto hull = adjacent[3 * first + (cornerOf(first) + 2) % 3] < 0;
+			auto out = graphFirst[v], last = graphFirst[v + 1];
+			auto t = first, previous = first;
+
+			polygon.clear();
+			do {
+				auto i = cornerOf(t);
+
+				graph[out++] = corner(t, (i + 2) % 3);
+				polygon.push_back(centres[t]);
+
+				previous = t;
+				t = adjacent[3 * t + i];
+			} while (t >= 0 && t != first && out < last - (hull ? 1 : 0));
+
+			// a hull cell is open between the rays out of its first and last hull edges
+			if (hull) {
+				auto i = cornerOf(first), j = cornerOf(previous);
+				auto firstRay = outward(xyz[corner(first, (i + 2) % 3)], xyz[v], xyz[corner(first, (i + 1) % 3)]);
+				auto lastRay = outward(xyz[v], xyz[corner(previous, (j + 1) % 3)], xyz[corner(previous, (j + 2) % 3)]);
+				auto &firstCentre = centres[first], &lastCentre = centres[previous];
+
+				graph[out++] = corner(previous, (j + 1) % 3);
+
+				auto far = 4.0 * (radius + std::max(away(xyz[v]), std::max(away(firstCentre), away(lastCentre))));
+				XYZ middle(firstRay.x + lastRay.x, firstRay.y + lastRay.y, 0.0);
+				auto middleLength = std::sqrt(middle.x * middle.x + middle.y * middle.y);
+
+				polygon.push_back(XYZ(lastCentre.x + far * lastRay.x, lastCentre.y + far * lastRay.y, 0.0));
+				if (middleLength > 1e-12)
+					polygon.push_back(XYZ(xyz[v].x + far * middle.x / middleLength, xyz[v].y + far * middle.y / middleLength, 0.0));
+				polygon.push_back(XYZ(firstCentre.x + far * firstRay.x, firstCentre.y + far * firstRay.y, 0.0));
+			}
+
+			clip(polygon, scratch, [&](const XYZ &point) { return point.x - xMin; });
+			clip(polygon, scratch, [&](const XYZ &point) { return xMax - point.x; });
+			clip(polygon, scratch, [&](const XYZ &point) { return point.y - yMin; });
+			clip(polygon, scratch, [&](const XYZ &point) { return yMax - point.y; });
+
+			// with counterclockwise triangles the walk went clockwise
+			if (winding > 0.0) {
+				std::reverse(graph.begin() + graphFirst[v], graph.begin() + out);
+				std::reverse(polygon.begin(), polygon.end());
+			}
+
+			size[v] = std::min(static_cast<int>(polygon.size()), graphFirst[v + 1] - graphFirst[v] + CELL_EXTRA);
+			std::copy(polygon.begin(), polygon.begin() + size[v], spare.begin() + graphFirst[v] + CELL_EXTRA * static_cast<size_t>(v));
+		}
+	});
+
+	for (int v = 0; v < pointNumb; v++)
+		polygonFirst[v + 1] = polygonFirst[v] + size[v];
+
+	polygons.resize(polygonFirst[pointNumb]);
+
+	inParallel(pointNumb, threadNumber, [&](size_t begin, size_t end) {
+		for (auto v = begin; v < end; v++) {
+			auto from = spare.begin() + graphFirst[v] + CELL_EXTRA * v;
+			std::copy(from, from + size[v], polygons.begin() + polygonFirst[v]);
+		}
+	});
+}
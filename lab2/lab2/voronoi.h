@@ -0,0 +1,41 @@
+#pragma once
+#include <vector>
+#include "triangulate.h"
+
+/*
+The dual of a finished triangulation, as both engines give it: the Voronoi
+vertex of each triangle (its circumcentre), the Voronoi cell of each point
+clipped to a box, and the Delaunay graph. Each point's neighbours and cell
+come from one walk round the triangles at it, so everything is built in
+time linear in the triangles, with the circumcentres and the walks split
+over threadNumber threads, 0 for every hardware thread.
+Neighbours and cells are kept in CSR form: the entries of point v run from
+first[v] to first[v + 1], counterclockwise round it.
+A point in no triangle has no neighbours and no cell
+*/
+class VoronoiDiagram {
+public:
+	VoronoiDiagram(int pointNumb, const XYZ *xyz, const Triangle *triangles, int triangleNumber,
+		double xMin, double yMin, double xMax, double yMax, int threadNumber = 0);
+
+	// circumcentre of each triangle, by triangle index
+	const std::vector<XYZ> &vertices() const { return centres; }
+
+	const std::vector<int> &neighbourFirst() const { return graphFirst; }
+	const std::vector<int> &neighbours() const { return graph; }
+
+	const std::vector<int> &cellFirst() const { return polygonFirst; }
+	const std::vector<XYZ> &cells() const { return polygons; }
+
+	int neighbourNumber(int point) const { return graphFirst[point + 1] - graphFirst[point]; }
+	const int *neighbours(int point) const { return graph.data() + graphFirst[point]; }
+
+	int cellSize(int point) const { return polygonFirst[point + 1] - polygonFirst[point]; }
+	const XYZ *cell(int point) const { return polygons.data() + polygonFirst[point]; }
+
+private:
+	std::vector<XYZ> centres;
+	std::vector<int> graphFirst, graph;
+	std::vector<int> polygonFirst;
+	std::vector<XYZ> polygons;
+};
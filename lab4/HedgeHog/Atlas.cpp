@@ -0,0 +1,298 @@
+#include "Atlas.h"
+#include "Hash.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <SOIL/SOIL.h>
+
+std::string Atlas::cacheFile = "atlas.cache";
+
+static const char MAGIC[4] = { 'A', 'T', 'L', 'S' };
+
+// edge pixels copied round each image, so filtering and the first mipmaps don't reach a neighbour
+static const int BORDER = 4;
+static const int LEVELS = 2; // mipmaps above the first, a level halves the border
+
+/*
+Average the source pixels under each target pixel, weighting colours by
+alpha so that the colour of transparent pixels doesn't darken the edges
+*/
+static void shrink(const unsigned char *source, int sourceWidth, int sourceHeight,
+	unsigned char *target, int targetWidth, int targetHeight) {
+
+	for (auto y = 0; y < targetHeight; y++) {
+		auto y0 = y * sourceHeight / targetHeight, y1 = (y + 1) * sourceHeight / targetHeight;
+
+		for (auto x = 0; x < targetWidth; x++) {
+			auto x0 = x * sourceWidth / targetWidth, x1 = (x + 1) * sourceWidth / targetWidth;
+			unsigned long long sum[4] = {};
+
+			for (auto sy = y0; sy < y1; sy++) {
+				auto pixel = source + 4 * (static_cast<size_t>(sy) * sourceWidth + x0);
+				for (auto sx = x0; sx < x1; sx++, pixel += 4) {
+					sum[0] += pixel[0] * pixel[3];
+					sum[1] += pixel[1] * pixel[3];
+					sum[2] += pixel[2] * pixel[3];
+					sum[3] += pixel[3];
+				}
+			}
+
+			auto out = target + 4 * (static_cast<size_t>(y) * targetWidth + x);
+			auto count = static_cast<unsigned long long>(y1 - y0) * (x1 - x0);
+			for (auto c = 0; c < 3; c++)
+				out[c] = sum[3] ? static_cast<unsigned char>((sum[c] + sum[3] / 2) / sum[3]) : 0;
+			out[3] = static_cast<unsigned char>((sum[3] + count / 2) / count);
+		}
+	}
+}
+
+Atlas::Atlas(const std::vector<Image> &images)
+	: Texture(0), images(images), atlasWidth(0), atlasHeight(0), hash(0),
+	fromCache(false), failed(false), loaded(false) {
+
+	loader = std::thread(&Atlas::load, this);
+}
+
+Atlas::~Atlas() {
+	if (loader.joinable())
+		loader.join();
+}
+
+void Atlas::load() {
+	Profiler::nameThread("atlas");
+	{
+		PROFILE_SCOPE("hash files");
+		hashFiles();
+	}
+	{
+		PROFILE_SCOPE("read cache");
+		fromCache = read();
+	}
+
+	if (!fromCache) {
+		decode();
+		if (!failed) {
+			PROFILE_SCOPE("write cache");
+			write();
+		}
+	}
+
+	loaded = true;
+}
+
+// the image files as they are on disk and the sizes asked for
+void Atlas::hashFiles() {
+	hash = FNV_OFFSET;
+	fnv1a(hash, MAGIC, sizeof(MAGIC));
+	fnv1a(hash, &BORDER, sizeof(BORDER));
+
+	for (auto &image : images) {
+		std::ifstream file(image.path, std::ios::binary);
+		std::stringstream content;
+		content << file.rdbuf();
+
+		auto data = content.str();
+		fnv1a(hash, image.path.c_str(), image.path.size() + 1);
+		fnv1a(hash, data.data(), data.size());
+		fnv1a(hash, &image.width, sizeof(image.width));
+		fnv1a(hash, &image.height, sizeof(image.height));
+	}
+}
+
+// the file is MAGIC, the hash, the atlas size, the image count, a rect for each image and the pixels
+bool Atlas::read() {
+	std::ifstream file(cacheFile, std::ios::binary);
+	if (!file)
+		return false;
+
+	char magic[sizeof(MAGIC)];
+	unsigned long long fileHash;
+	int count;
+
+	file.read(magic, sizeof(magic));
+	file.read(reinterpret_cast<char*>(&fileHash), sizeof(fileHash));
+	file.read(reinterpret_cast<char*>(&atlasWidth), sizeof(atlasWidth));
+	file.read(reinterpret_cast<char*>(&atlasHeight), sizeof(atlasHeight));
+	file.read(reinterpret_cast<char*>(&count), sizeof(count));
+
+	if (!file || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || fileHash != hash
+		|| count != static_cast<int>(images.size()) || atlasWidth <= 0 || atlasHeight <= 0)
+		return false;
+
+	rects.resize(count);
+	file.read(reinterpret_cast<char*>(rects.data()), count * sizeof(Rect));
+
+	pixels.resize(4 * static_cast<size_t>(atlasWidth) * atlasHeight);
+	file.read(reinterpret_cast<char*>(pixels.data()), pixels.size());
+
+	return static_cast<bool>(file);
+}
+
+void Atlas::write() const {
+	std::ofstream file(cacheFile, std::ios::binary | std::ios::trunc);
+	auto count = static_cast<int>(images.size());
+
+	file.write(MAGIC, sizeof(MAGIC));
+	file.write(reinterpret_cast<const char*>(&hash), sizeof(hash));
+	file.write(reinterpret_cast<const char*>(&atlasWidth), sizeof(atlasWidth));
+	file.write(reinterpret_cast<const char*>(&atlasHeight), sizeof(atlasHeight));
+	file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+	file.write(reinterpret_cast<const char*>(rects.data()), count * sizeof(Rect));
+	file.write(reinterpret_cast<const char*>(pixels.data()), pixels.size());
+
+	if (!file)
+		std::cout << "ERROR::ATLAS::CACHE_NOT_WRITTEN " << cacheFile << std::endl;
+}
+
+// decode and shrink the images on as many threads as there are cores, then pack them
+void Atlas::decode() {
+	auto count = images.size();
+	std::vector<std::vector<unsigned char>> shrunk(count);
+	std::vector<Rect> sizes(count);
+
+	std::atomic<size_t> next(0);
+	std::atomic<bool> anyFailed(false);
+
+	auto work = [&]() {
+		for (size_t i; (i = next++) < count;) {
+			PROFILE_SCOPE("decode image");
+			int width, height;
+			auto image = SOIL_load_image(images[i].path.c_str(), &width, &height, nullptr, SOIL_LOAD_RGBA);
+
+			if (!image) {
+				std::cout << "ERROR::ATLAS::IMAGE_NOT_LOADED " << images[i].path << std::endl;
+				anyFailed = true;
+				sizes[i] = { 0, 0, 1, 1 };
+				shrunk[i].assign(4, 0);
+				continue;
+			}
+
+			// never grown, a small image is stretched by the sampler instead
+			auto targetWidth = std::max(1, std::min(width, images[i].width));
+			auto targetHeight = std::max(1, std::min(height, images[i].height));
+
+			sizes[i] = { 0, 0, targetWidth, targetHeight };
+			shrunk[i].resize(4 * static_cast<size_t>(targetWidth) * targetHeight);
+			shrink(image, width, height, shrunk[i].data(), targetWidth, targetHeight);
+
+			SOIL_free_image_data(image);
+		}
+	};
+
+	auto threadNumber = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), count);
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < threadNumber; i++)
+		threads.push_back(std::thread(work));
+	work();
+	for (auto &thread : threads)
+		thread.join();
+
+	failed = anyFailed;
+	PROFILE_SCOPE("pack");
+	pack(shrunk, sizes);
+}
+
+/*
+Shelves, tallest images first: an image goes to the right of the last one
+until the row is full, then a new row starts under the tallest of it.
+The atlas is about as wide as it would be square
+*/
+void Atlas::pack(const std::vector<std::vector<unsigned char>> &shrunk, const std::vector<Rect> &sizes) {
+	auto count = sizes.size();
+	std::vector<size_t> order(count);
+	for (size_t i = 0; i < count; i++)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sizes[a].height > sizes[b].height; });
+
+	auto area = 0.0;
+	auto widest = 0;
+	for (auto &size : sizes) {
+		area += static_cast<double>(size.width + 2 * BORDER) * (size.height + 2 * BORDER);
+		widest = std::max(widest, size.width + 2 * BORDER);
+	}
+	atlasWidth = std::max(widest, static_cast<int>(std::ceil(std::sqrt(area))));
+
+	rects.resize(count);
+	auto x = 0, y = 0, rowHeight = 0;
+	for (auto i : order) {
+		auto width = sizes[i].width + 2 * BORDER, height = sizes[i].height + 2 * BORDER;
+		if (x + width > atlasWidth) {
+			y += rowHeight;
+			x = rowHeight = 0;
+		}
+
+		rects[i] = { x + BORDER, y + BORDER, sizes[i].width, sizes[i].height };
+		x += width;
+		rowHeight = std::max(rowHeight, height);
+	}
+	atlasHeight = y + rowHeight;
+
+	pixels.assign(4 * static_cast<size_t>(atlasWidth) * atlasHeight, 0);
+
+	for (size_t i = 0; i < count; i++) {
+		auto &rect = rects[i];
+		for (auto ty = -BORDER; ty < rect.height + BORDER; ty++) {
+			auto sy = std::min(std::max(ty, 0), rect.height - 1);
+			auto row = &pixels[4 * (static_cast<size_t>(rect.y + ty) * atlasWidth + rect.x)];
+
+			for (auto tx = -BORDER; tx < rect.width + BORDER; tx++) {
+				auto sx = std::min(std::max(tx, 0), rect.width - 1);
+				memcpy(row + 4 * tx, &shrunk[i][4 * (static_cast<size_t>(sy) * rect.width + sx)], 4);
+			}
+		}
+	}
+}
+
+bool Atlas::finish() {
+	if (loader.joinable())
+		loader.join();
+
+	glGenTextures(1, &Texture);
+	glBindTexture(GL_TEXTURE_2D, Texture);
+
+	/*
+	The pixels go through a buffer: glTexImage2D then only queues the copy
+	from it, and the driver does it while the game goes on
+	*/
+	GLuint buffer;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, pixels.size(), nullptr, GL_STREAM_DRAW);
+
+	auto mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, pixels.size(), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (mapped) {
+		memcpy(mapped, pixels.data(), pixels.size());
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, atlasWidth, atlasHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	} else {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, atlasWidth, atlasHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	}
+	glDeleteBuffers(1, &buffer);
+
+	// Parameters
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, LEVELS);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	std::vector<unsigned char>().swap(pixels);
+
+	regions.resize(rects.size());
+	for (size_t i = 0; i < rects.size(); i++) {
+		auto &rect = rects[i];
+		regions[i] = { Texture, static_cast<GLfloat>(rect.x) / atlasWidth, static_cast<GLfloat>(rect.y) / atlasHeight,
+			static_cast<GLfloat>(rect.width) / atlasWidth, static_cast<GLfloat>(rect.height) / atlasHeight };
+	}
+
+	return !failed;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "SpriteBatch.h"
+
+/*
+Every sprite image in one texture, so that a frame binds a single texture.
+The images are decoded side by side on worker threads, each shrunk to the
+largest size it is drawn at, and packed in shelves with a border of copied
+edge pixels round each one. The packed atlas is kept in cacheFile together
+with a hash of the image files and sizes, so a later start with the same
+images reads it back instead of decoding.
+All of that happens on a thread of its own, started by the constructor;
+finish() waits for it and uploads the atlas through a pixel buffer, so it
+and every region are only valid after finish()
+*/
+class Atlas {
+public:
+	struct Image {
+		std::string path;
+		int width, height; // the most pixels it covers on screen
+	};
+
+	GLuint Texture;
+
+	static std::string cacheFile;
+
+	explicit Atlas(const std::vector<Image> &images);
+	~Atlas();
+
+	bool ready() const { return loaded; }
+
+	// FALSE if an image couldn't be decoded, it is left transparent then
+	bool finish();
+
+	const TextureRegion &region(int image) const { return regions[image]; }
+
+	int width() const { return atlasWidth; }
+	int height() const { return atlasHeight; }
+	bool cached() const { return fromCache; }
+
+private:
+	struct Rect {
+		int x, y, width, height;
+	};
+
+	std::vector<Image> images;
+	std::vector<Rect> rects;
+	std::vector<TextureRegion> regions;
+	std::vector<unsigned char> pixels; // RGBA, rows from the top, until finish()
+
+	int atlasWidth, atlasHeight;
+	unsigned long long hash;
+	bool fromCache, failed;
+
+	std::atomic<bool> loaded;
+	std::thread loader;
+
+	void load();
+	void hashFiles();
+	bool read();
+	void write() const;
+	void decode();
+	void pack(const std::vector<std::vector<unsigned char>> &shrunk, const std::vector<Rect> &sizes);
+
+	Atlas(const Atlas &) = delete;
+	Atlas &operator=(const Atlas &) = delete;
+};
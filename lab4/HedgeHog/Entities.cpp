@@ -0,0 +1,70 @@
+#include "Entities.h"
+
+Entity Entities::create() {
+	unsigned slot;
+	if (freeSlots.empty()) {
+		slot = static_cast<unsigned>(generations.size());
+		generations.push_back(0);
+		indices.push_back(-1);
+	} else {
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+
+	indices[slot] = size();
+	slots.push_back(slot);
+
+	x.push_back(0.0f);
+	y.push_back(0.0f);
+	width.push_back(0.0f);
+	height.push_back(0.0f);
+	sprite.push_back(0);
+	layer.push_back(0);
+
+	return { slot, generations[slot] };
+}
+
+void Entities::destroy(Entity entity) {
+	if (!alive(entity))
+		return;
+
+	auto index = indices[entity.slot];
+	auto last = size() - 1;
+	if (index != last) {
+		move(last, index);
+		slots[index] = slots[last];
+		indices[slots[index]] = index;
+	}
+	pop();
+	slots.pop_back();
+
+	velocity.remove(entity.slot);
+	reach.remove(entity.slot);
+	edible.remove(entity.slot);
+
+	generations[entity.slot]++;
+	indices[entity.slot] = -1;
+	freeSlots.push_back(entity.slot);
+}
+
+bool Entities::alive(Entity entity) const {
+	return entity.slot < generations.size() && generations[entity.slot] == entity.generation && indices[entity.slot] >= 0;
+}
+
+void Entities::move(int from, int to) {
+	x[to] = x[from];
+	y[to] = y[from];
+	width[to] = width[from];
+	height[to] = height[from];
+	sprite[to] = sprite[from];
+	layer[to] = layer[from];
+}
+
+void Entities::pop() {
+	x.pop_back();
+	y.pop_back();
+	width.pop_back();
+	height.pop_back();
+	sprite.pop_back();
+	layer.pop_back();
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <vector>
+
+/*
+A handle to an entity that stays valid while the entity lives, wherever
+its components move to; once it is destroyed, the handle is stale even
+after the slot is given to a new entity
+*/
+struct Entity {
+	unsigned slot, generation;
+};
+
+/*
+A component only some entities have, packed apart from the rest so that a
+system over it visits only them, in the order of values. It is kept by
+slot, so it doesn't change when the entities' own arrays do
+*/
+template <typename T>
+class ComponentSet {
+public:
+	std::vector<T> values;
+	std::vector<unsigned> owners; // the slot of the entity each value belongs to
+
+	void add(unsigned slot, const T &value) {
+		if (slot >= where.size())
+			where.resize(slot + 1, -1);
+
+		if (where[slot] >= 0) {
+			values[where[slot]] = value;
+			return;
+		}
+
+		where[slot] = size();
+		values.push_back(value);
+		owners.push_back(slot);
+	}
+
+	void remove(unsigned slot) {
+		if (!has(slot))
+			return;
+
+		auto index = where[slot];
+		values[index] = values.back();
+		owners[index] = owners.back();
+		where[owners[index]] = index;
+		values.pop_back();
+		owners.pop_back();
+		where[slot] = -1;
+	}
+
+	bool has(unsigned slot) const { return slot < where.size() && where[slot] >= 0; }
+	T &operator[](unsigned slot) { return values[where[slot]]; }
+	const T &operator[](unsigned slot) const { return values[where[slot]]; }
+
+	int size() const { return static_cast<int>(values.size()); }
+
+private:
+	std::vector<int> where; // index in values by slot, -1 for none
+};
+
+struct Velocity {
+	float x, y; // a second
+};
+
+/*
+Entities as components in structure-of-arrays form. What every entity
+has is an array of its own, and the entities alive are packed at the front
+of them all, so a system reads only the arrays it needs, from start to end.
+Destroying an entity moves the last one into its place; handles find them
+through their slot wherever they are.
+What only a few entities have is a ComponentSet, so the systems over it
+don't walk past all the others.
+A new component needs its array and a line in create(), move() and pop(),
+or a set and a line in destroy()
+*/
+class Entities {
+public:
+	// position
+	std::vector<float> x, y;
+	// half the size it is drawn at; a negative width flips the sprite
+	std::vector<float> width, height;
+	// the picture, drawn over every entity of a lower layer
+	std::vector<unsigned char> sprite, layer;
+
+	ComponentSet<Velocity> velocity;
+	ComponentSet<float> reach;          // eats the edible entities this close to it
+	ComponentSet<unsigned char> edible;
+
+	Entity create();
+	void destroy(Entity entity);
+
+	bool alive(Entity entity) const;
+
+	// where the entity's components are now
+	int index(Entity entity) const { return indices[entity.slot]; }
+	int index(unsigned slot) const { return indices[slot]; }
+
+	Entity entity(unsigned slot) const { return { slot, generations[slot] }; }
+
+	int size() const { return static_cast<int>(slots.size()); }
+
+private:
+	std::vector<unsigned> generations; // by slot
+	std::vector<int> indices;          // by slot, -1 while the slot is free
+	std::vector<unsigned> slots;       // by index
+	std::vector<unsigned> freeSlots;
+
+	void move(int from, int to);
+	void pop();
+};
@@ -0,0 +1,386 @@
+#include "Game.h"
+#include "Hash.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+const double Ratios::GRASS = 1.0;
+const double Ratios::HEDGEHOG = 0.15;
+const double Ratios::APPLE = 0.075;
+
+const float Game::TICK = 1.0f / 120;
+
+static const auto SPEED = 2.0f;
+static const auto APPLE_SPACING = 0.2f; // least distance between apples, if that many fit
+static const auto APPLE_MARGIN = 0.1f;  // from the edges of a chunk, so apples of two chunks are APPLE_SPACING apart too
+static const auto CHUNK = 2.0f;         // the size of the screen
+static const auto EAT_DISTANCE = 0.15f;
+static const glm::vec3 front = glm::vec3(0.0, 0.5, 0.0);
+static const glm::vec3 right = glm::vec3(0.5, 0.0, 0.0);
+
+static const char MAGIC[4] = { 'H', 'H', 'R', 'P' };
+static const char WORLD_MAGIC[4] = { 'H', 'H', 'R', 'W' };
+static const Entity NO_ENTITY = { ~0u, 0 };
+
+Level Level::screen(int appleNumber) {
+	Level level;
+	level.applesPerChunk = appleNumber;
+	level.residentChunks = 1;
+	return level;
+}
+
+Level Level::world(int chunks, int applesPerChunk) {
+	Level level;
+	level.chunks = std::max(chunks, 1);
+	level.applesPerChunk = applesPerChunk;
+	return level;
+}
+
+Game::Chunk::Chunk(int column, int row, float minX, float minY)
+	: column(column), row(row), grass(NO_ENTITY), edibles(minX, minY, minX + CHUNK, minY + CHUNK, EAT_DISTANCE), used(0) {}
+
+Game::Game(const Level &level, unsigned seed)
+	: level(level), seed(seed), win(false), tickNumber(0), centre(-1), prefetched(false) {
+
+	left = static_cast<long long>(level.chunks) * level.chunks * std::max(level.applesPerChunk, 0);
+
+	player = sprite(HEDGEHOG_SPRITE, PLAYER, 0.0f, 0.0f, Ratios::HEDGEHOG);
+	world.velocity.add(player.slot, { 0.0f, 0.0f });
+	world.reach.add(player.slot, EAT_DISTANCE);
+
+	stream();
+}
+
+int Game::chunkAt(float coordinate) const {
+	auto chunk = static_cast<int>(std::floor((coordinate + edge()) / CHUNK));
+	return std::min(std::max(chunk, 0), level.chunks - 1);
+}
+
+/*
+Each chunk has a random engine of its own, so that its apples are the same
+whenever it is made, whichever way the hedgehog came; chunk 0, 0 takes the
+seed as it is, the screen level's apples are the ones it always had
+*/
+void Game::load(int column, int row) {
+	auto minX = CHUNK * column - edge(), minY = CHUNK * row - edge();
+	auto key = row * level.chunks + column;
+	auto &chunk = chunks.emplace(key, Chunk(column, row, minX, minY)).first->second;
+	std::default_random_engine dre(seed ^ (static_cast<unsigned>(column) * 0x9E3779B9u) ^ (static_cast<unsigned>(row) * 0x85EBCA6Bu));
+
+	/*
+	Generate apples so that they don't overlap. At 0.7 of the spacing that
+	would share the chunk out evenly, Poisson-disk points come to about a
+	quarter more than the apples; if there are too few anyway, it shrinks
+	*/
+	auto appleNumber = std::max(level.applesPerChunk, 0);
+	auto side = CHUNK - 2 * APPLE_MARGIN;
+	auto spacing = std::min(APPLE_SPACING, 0.7f * std::sqrt(side * side / std::max(appleNumber, 1)));
+	std::vector<glm::vec3> applePositions;
+	for (;;) {
+		applePositions = poissonDisk(minX + APPLE_MARGIN, minY + APPLE_MARGIN, minX + CHUNK - APPLE_MARGIN, minY + CHUNK - APPLE_MARGIN, spacing, dre);
+		if (static_cast<int>(applePositions.size()) >= appleNumber)
+			break;
+		spacing *= 0.8f;
+	}
+
+	// The points spread out from the first one found, so take a random choice of them
+	std::shuffle(applePositions.begin(), applePositions.end(), dre);
+	applePositions.resize(appleNumber);
+
+	chunk.grass = sprite(GRASS_SPRITE, GROUND, minX + CHUNK / 2, minY + CHUNK / 2, Ratios::GRASS);
+
+	auto eatenHere = eatenApples.find(key);
+	chunk.apples.reserve(appleNumber);
+	for (auto i = 0; i < appleNumber; i++) {
+		if (eatenHere != eatenApples.end() && eatenHere->second[i]) {
+			chunk.apples.push_back(NO_ENTITY);
+			continue;
+		}
+
+		auto &position = applePositions[i];
+		auto apple = sprite(APPLE_SPRITE, FRUIT, position.x, position.y, Ratios::APPLE);
+		world.edible.add(apple.slot, 1);
+		chunk.edibles.insert(i, position);
+		chunk.apples.push_back(apple);
+	}
+}
+
+void Game::evict(std::map<int, Chunk>::iterator chunk) {
+	world.destroy(chunk->second.grass);
+	for (auto apple : chunk->second.apples)
+		world.destroy(apple);
+	chunks.erase(chunk);
+}
+
+Entity Game::sprite(Sprite sprite, Layer layer, float x, float y, double ratio) {
+	auto entity = world.create();
+	auto i = world.index(entity);
+
+	world.x[i] = x;
+	world.y[i] = y;
+	world.width[i] = world.height[i] = static_cast<float>(ratio);
+	world.sprite[i] = sprite;
+	world.layer[i] = layer;
+	return entity;
+}
+
+glm::vec3 Game::hedgehog() const {
+	auto i = world.index(player);
+	return glm::vec3(world.x[i], world.y[i], 0.0f);
+}
+
+glm::vec3 Game::camera() const {
+	return level.chunks == 1 ? glm::vec3() : hedgehog();
+}
+
+// the sprite faces left as it is, a negative width turns it right
+bool Game::facingLeft() const {
+	return world.width[world.index(player)] > 0;
+}
+
+void Game::step(unsigned input) {
+	tickNumber++;
+
+	steer(input);
+	move();
+	stream();
+	eat();
+
+	if (!win && left == 0) {
+		win = true;
+		sprite(CONGRATS_SPRITE, BANNER, 0.0f, 0.0f, Ratios::GRASS);
+	}
+}
+
+// the keys give the hedgehog its velocity, and turn it to the last way it went sideways
+void Game::steer(unsigned input) {
+	auto &velocity = world.velocity[player.slot];
+	auto &width = world.width[world.index(player)];
+	velocity = { 0.0f, 0.0f };
+
+	if (input & FORWARD)
+		velocity.y += SPEED * front.y;
+	if (input & BACKWARD)
+		velocity.y -= SPEED * front.y;
+
+	if (input & LEFT) {
+		velocity.x -= SPEED * right.x;
+		width = std::abs(width);
+	}
+	if (input & RIGHT) {
+		velocity.x += SPEED * right.x;
+		width = -std::abs(width);
+	}
+}
+
+void Game::move() {
+	auto &velocity = world.velocity;
+	for (auto k = 0; k < velocity.size(); k++) {
+		auto i = world.index(velocity.owners[k]);
+		auto &x = world.x[i], &y = world.y[i];
+
+		x += velocity.values[k].x * TICK;
+		y += velocity.values[k].y * TICK;
+
+		if (level.chunks == 1) {
+			// Wrap the screen
+			if (y > 1 || y < -1)
+				y = -y;
+			if (x > 1 || x < -1)
+				x = -x;
+		} else {
+			// Walls round the level
+			x = std::min(std::max(x, -edge()), edge());
+			y = std::min(std::max(y, -edge()), edge());
+		}
+	}
+}
+
+/*
+When the hedgehog comes into a new chunk, the ones next to it are made if
+they aren't there, and past the budget those it left longest ago go.
+Making a chunk takes milliseconds, so the ones a chunk further are made
+ahead of it, one a tick, while the budget has room
+*/
+void Game::stream() {
+	auto position = hedgehog();
+	auto column = chunkAt(position.x), row = chunkAt(position.y);
+	auto key = row * level.chunks + column;
+
+	if (key != centre) {
+		centre = key;
+		prefetched = false;
+
+		for (auto r = std::max(row - 1, 0); r <= std::min(row + 1, level.chunks - 1); r++)
+			for (auto c = std::max(column - 1, 0); c <= std::min(column + 1, level.chunks - 1); c++) {
+				if (!chunks.count(r * level.chunks + c))
+					load(c, r);
+				chunks.at(r * level.chunks + c).used = tickNumber;
+			}
+
+		while (static_cast<int>(chunks.size()) > std::max(level.residentChunks, 9)) {
+			auto oldest = chunks.begin();
+			for (auto chunk = chunks.begin(); chunk != chunks.end(); ++chunk)
+				if (chunk->second.used < oldest->second.used)
+					oldest = chunk;
+			evict(oldest);
+		}
+	}
+
+	if (prefetched || static_cast<int>(chunks.size()) >= level.residentChunks)
+		return;
+
+	for (auto r = std::max(row - 2, 0); r <= std::min(row + 2, level.chunks - 1); r++)
+		for (auto c = std::max(column - 2, 0); c <= std::min(column + 2, level.chunks - 1); c++)
+			if (!chunks.count(r * level.chunks + c)) {
+				load(c, r);
+				chunks.at(r * level.chunks + c).used = tickNumber;
+				return;
+			}
+	prefetched = true;
+}
+
+// only the chunks the reach overlaps are looked in; they are round the eater, so they are there
+void Game::eat() {
+	auto &reach = world.reach;
+	for (auto k = 0; k < reach.size(); k++) {
+		auto i = world.index(reach.owners[k]);
+		auto position = glm::vec3(world.x[i], world.y[i], 0.0f);
+		auto radius = reach.values[k];
+
+		for (auto row = chunkAt(position.y - radius); row <= chunkAt(position.y + radius); row++)
+			for (auto column = chunkAt(position.x - radius); column <= chunkAt(position.x + radius); column++) {
+				auto key = row * level.chunks + column;
+				auto found = chunks.find(key);
+				if (found == chunks.end())
+					continue;
+
+				auto &chunk = found->second;
+				eaten.clear();
+				chunk.edibles.query(position, radius, eaten);
+
+				for (auto number : eaten) {
+					auto apple = chunk.apples[number];
+					auto j = world.index(apple);
+					chunk.edibles.remove(number, glm::vec3(world.x[j], world.y[j], 0.0f));
+					world.destroy(apple);
+
+					auto &eatenHere = eatenApples[key];
+					if (eatenHere.empty())
+						eatenHere.resize(chunk.apples.size());
+					eatenHere[number] = true;
+					left--;
+				}
+			}
+	}
+}
+
+void Game::extract(Frame &frame) const {
+	auto view = camera();
+	frame.sprites.clear();
+	frame.culled = 0;
+
+	for (auto layer = 0; layer < LAYERS; layer++) {
+		// the banner stays on the screen wherever the hedgehog is
+		auto viewX = layer == BANNER ? 0.0f : view.x, viewY = layer == BANNER ? 0.0f : view.y;
+
+		for (auto i = 0; i < world.size(); i++)
+			if (world.layer[i] == layer) {
+				auto x = world.x[i] - viewX, y = world.y[i] - viewY;
+				if (std::abs(x) - std::abs(world.width[i]) > 1.0f || std::abs(y) - std::abs(world.height[i]) > 1.0f) {
+					frame.culled++;
+					continue;
+				}
+
+				Frame::Sprite sprite = { x, y, world.width[i], world.height[i], world.sprite[i] };
+				frame.sprites.push_back(sprite);
+			}
+	}
+
+	frame.tick = tickNumber;
+	frame.applesLeft = applesLeft();
+	frame.won = win;
+}
+
+unsigned long long Game::checksum() const {
+	auto hash = FNV_OFFSET;
+	auto facing = facingLeft();
+	auto position = hedgehog();
+
+	fnv1a(hash, &tickNumber, sizeof(tickNumber));
+	fnv1a(hash, &position.x, sizeof(float));
+	fnv1a(hash, &position.y, sizeof(float));
+	fnv1a(hash, &facing, sizeof(facing));
+	fnv1a(hash, &win, sizeof(win));
+
+	// apples eaten in chunks no longer made; a screen level has all of its own, and hashes as it always did
+	if (level.chunks > 1)
+		fnv1a(hash, &left, sizeof(left));
+
+	for (auto slot : world.edible.owners) {
+		auto i = world.index(slot);
+		fnv1a(hash, &world.x[i], sizeof(float));
+		fnv1a(hash, &world.y[i], sizeof(float));
+	}
+	return hash;
+}
+
+bool Replay::save(const std::string &path) const {
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	auto tickNumber = static_cast<long long>(inputs.size());
+
+	file.write(level.chunks == 1 ? MAGIC : WORLD_MAGIC, sizeof(MAGIC));
+	file.write(reinterpret_cast<const char*>(&level.applesPerChunk), sizeof(level.applesPerChunk));
+	if (level.chunks != 1) {
+		file.write(reinterpret_cast<const char*>(&level.chunks), sizeof(level.chunks));
+		file.write(reinterpret_cast<const char*>(&level.residentChunks), sizeof(level.residentChunks));
+	}
+	file.write(reinterpret_cast<const char*>(&seed), sizeof(seed));
+	file.write(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+	file.write(reinterpret_cast<const char*>(&tickNumber), sizeof(tickNumber));
+	file.write(reinterpret_cast<const char*>(inputs.data()), inputs.size());
+
+	if (!file) {
+		std::cout << "ERROR::REPLAY::NOT_WRITTEN " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool Replay::load(const std::string &path) {
+	std::ifstream file(path, std::ios::binary);
+	char magic[sizeof(MAGIC)];
+	long long tickNumber = 0;
+
+	file.read(magic, sizeof(magic));
+	auto isWorld = memcmp(magic, WORLD_MAGIC, sizeof(WORLD_MAGIC)) == 0;
+
+	level = Level();
+	file.read(reinterpret_cast<char*>(&level.applesPerChunk), sizeof(level.applesPerChunk));
+	if (isWorld) {
+		file.read(reinterpret_cast<char*>(&level.chunks), sizeof(level.chunks));
+		file.read(reinterpret_cast<char*>(&level.residentChunks), sizeof(level.residentChunks));
+	} else {
+		level.residentChunks = 1;
+	}
+	file.read(reinterpret_cast<char*>(&seed), sizeof(seed));
+	file.read(reinterpret_cast<char*>(&checksum), sizeof(checksum));
+	file.read(reinterpret_cast<char*>(&tickNumber), sizeof(tickNumber));
+
+	if (!file || (!isWorld && memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) || tickNumber < 0 || level.chunks < 1) {
+		std::cout << "ERROR::REPLAY::NOT_A_REPLAY " << path << std::endl;
+		return false;
+	}
+
+	inputs.resize(static_cast<size_t>(tickNumber));
+	file.read(reinterpret_cast<char*>(inputs.data()), inputs.size());
+
+	if (!file) {
+		std::cout << "ERROR::REPLAY::TRUNCATED " << path << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,169 @@
+#pragma once
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Entities.h"
+#include "SpatialGrid.h"
+
+// Java Style
+struct Ratios {
+	static const double GRASS;
+	static const double HEDGEHOG;
+	static const double APPLE;
+};
+
+// what the window needs of a tick to draw it
+struct Frame {
+	struct Sprite {
+		float x, y, width, height;
+		unsigned char sprite;
+	};
+
+	std::vector<Sprite> sprites; // in the order they are drawn, on the screen
+	int culled = 0;              // sprites left out for being off the screen
+	long long tick = 0;
+	long long applesLeft = 0;
+	bool won = false;
+};
+
+/*
+How big the game is: chunks by chunks squares the size of the screen, with
+applesPerChunk apples in each. A level of one chunk is the screen the
+game always was, wrapping round at its edges; a bigger one is walled, and
+the screen follows the hedgehog over it.
+Only the chunks round the hedgehog are made into entities, and at most
+residentChunks are kept, those used last; the rest are made again from
+the seed when the hedgehog comes back, less the apples already eaten.
+Only the eaten apples of the chunks it has been to are kept besides
+*/
+struct Level {
+	int chunks = 1;
+	int applesPerChunk = 0;
+	int residentChunks = 25; // the five by five round the hedgehog; never fewer than the nine next to it
+
+	static Level screen(int appleNumber);
+	static Level world(int chunks, int applesPerChunk);
+};
+
+/*
+The game without a window: the grass, the hedgehog, the apples and the
+rules, moved on one fixed tick at a time by the keys held during it.
+Nothing depends on the frame rate, so the same level, seed and keys
+tick by tick give the same game bit for bit, as long as it is the same
+build (the standard library decides how the random engine's numbers
+become floats).
+Everything in it is an entity; the window only draws their sprites, the
+ones on the screen
+*/
+class Game {
+public:
+	// keys held during a tick, or-ed together
+	enum Input : unsigned char {
+		FORWARD = 1,
+		BACKWARD = 2,
+		LEFT = 4,
+		RIGHT = 8
+	};
+
+	// the pictures, in the order the atlas is given them
+	enum Sprite : unsigned char {
+		APPLE_SPRITE,
+		GRASS_SPRITE,
+		HEDGEHOG_SPRITE,
+		CONGRATS_SPRITE
+	};
+
+	enum Layer : unsigned char {
+		GROUND,
+		FRUIT,
+		PLAYER,
+		BANNER,
+		LAYERS
+	};
+
+	static const float TICK; // seconds
+
+	Game(int appleNumber, unsigned seed) : Game(Level::screen(appleNumber), seed) {}
+	Game(const Level &level, unsigned seed);
+
+	void step(unsigned input);
+
+	const Entities &entities() const { return world; }
+
+	// a sprite for every entity on the screen, layer by layer, in the order they are packed in
+	void extract(Frame &frame) const;
+
+	// where in the level; the screen is centred there unless the level is one chunk
+	glm::vec3 hedgehog() const;
+	glm::vec3 camera() const;
+	bool facingLeft() const;
+	long long applesLeft() const { return left; }
+	bool won() const { return win; }
+	long long ticks() const { return tickNumber; }
+
+	int residentChunks() const { return static_cast<int>(chunks.size()); }
+
+	// FNV-1a of the whole state, for telling two runs apart
+	unsigned long long checksum() const;
+
+private:
+	// a chunk made into entities; its apples by their number in it, stale once eaten
+	struct Chunk {
+		int column, row;
+		Entity grass;
+		std::vector<Entity> apples;
+		SpatialGrid edibles; // apple numbers by where they are
+		long long used;      // the last tick the hedgehog was near
+
+		Chunk(int column, int row, float minX, float minY);
+	};
+
+	Level level;
+	unsigned seed;
+
+	Entities world;
+	Entity player;
+	bool win;
+	long long tickNumber;
+	long long left;
+
+	std::map<int, Chunk> chunks;                           // resident ones, by row * level.chunks + column
+	std::unordered_map<int, std::vector<bool>> eatenApples; // by chunk, of every chunk something was eaten in
+	int centre;                                            // the chunk the hedgehog was in the last tick
+	bool prefetched;                                       // every chunk round centre made, or no room for more
+	std::vector<int> eaten;
+
+	Entity sprite(Sprite sprite, Layer layer, float x, float y, double ratio);
+
+	float edge() const { return static_cast<float>(level.chunks); }
+	int chunkAt(float coordinate) const;
+	void load(int column, int row);
+	void evict(std::map<int, Chunk>::iterator chunk);
+
+	// the systems, run in this order every tick
+	void steer(unsigned input);
+	void move();
+	void stream();
+	void eat();
+};
+
+/*
+The keys of every tick of a game and the checksum it ended with, all it
+takes to play it again without a window. The file is MAGIC, the apple
+number, the seed, the checksum, the tick count and a byte of keys a tick;
+for a level of more than one chunk it is WORLD_MAGIC, and the chunks and
+the resident chunks follow the apple number
+*/
+struct Replay {
+	Level level;
+	unsigned seed;
+	unsigned long long checksum;
+	std::vector<unsigned char> inputs;
+
+	bool save(const std::string &path) const;
+	bool load(const std::string &path);
+};
@@ -0,0 +1,14 @@
+#pragma once
+#include <cstddef>
+
+// where an FNV-1a hash starts
+static const unsigned long long FNV_OFFSET = 14695981039346656037ull;
+
+// FNV-1a: mix size bytes from data into hash
+inline void fnv1a(unsigned long long &hash, const void *data, size_t size) {
+	auto bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+}
@@ -0,0 +1,60 @@
+#include "RenderState.h"
+
+const GLuint RenderState::UNKNOWN;
+const int RenderState::UNITS;
+
+RenderState::RenderState() : frameCalls(0), frameSkipped(0), lastCalls(0), lastSkipped(0) {
+	forget();
+}
+
+void RenderState::forget() {
+	program = vertexArray = activeUnit = UNKNOWN;
+	for (auto &texture : textures)
+		texture = UNKNOWN;
+}
+
+void RenderState::useProgram(GLuint newProgram) {
+	if (program == newProgram) {
+		frameSkipped++;
+		return;
+	}
+
+	glUseProgram(newProgram);
+	program = newProgram;
+	frameCalls++;
+}
+
+void RenderState::bindTexture(GLuint unit, GLuint texture) {
+	if (unit < UNITS && textures[unit] == texture) {
+		frameSkipped++;
+		return;
+	}
+
+	if (activeUnit != unit) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		activeUnit = unit;
+		frameCalls++;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+	if (unit < UNITS)
+		textures[unit] = texture;
+	frameCalls++;
+}
+
+void RenderState::bindVertexArray(GLuint newVertexArray) {
+	if (vertexArray == newVertexArray) {
+		frameSkipped++;
+		return;
+	}
+
+	glBindVertexArray(newVertexArray);
+	vertexArray = newVertexArray;
+	frameCalls++;
+}
+
+void RenderState::newFrame() {
+	lastCalls = frameCalls;
+	lastSkipped = frameSkipped;
+	frameCalls = frameSkipped = 0;
+}
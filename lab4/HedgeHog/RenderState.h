@@ -0,0 +1,39 @@
+#pragma once
+
+#include <GL/glew.h>
+
+/*
+The GL state the game changes between draws, remembered so that a bind
+that wouldn't change anything isn't sent to the driver.
+Binds made through it are counted, and so are the calls the caller counts
+with count() (draws and uniforms), one frame at a time
+*/
+class RenderState {
+public:
+	RenderState();
+
+	void useProgram(GLuint program);
+	void bindTexture(GLuint unit, GLuint texture); // GL_TEXTURE_2D
+	void bindVertexArray(GLuint vertexArray);
+
+	void count(int calls = 1) { frameCalls += calls; }
+
+	// start a new frame; calls() and skipped() are then about the one that ended
+	void newFrame();
+
+	int calls() const { return lastCalls; }
+	int skipped() const { return lastSkipped; }
+
+	// after GL calls made around it, every next bind is sent again
+	void forget();
+
+private:
+	static const GLuint UNKNOWN = ~0u;
+	static const int UNITS = 8;
+
+	GLuint program, vertexArray, activeUnit;
+	GLuint textures[UNITS];
+
+	int frameCalls, frameSkipped;
+	int lastCalls, lastSkipped;
+};
@@ -0,0 +1,287 @@
+#include "Shader.h"
+#include "Hash.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+std::string Shader::cacheDirectory = "shadercache";
+
+static const char MAGIC[4] = { 'P', 'R', 'O', 'G' };
+
+static bool hasExtension(const char *name) {
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+
+	for (GLint i = 0; i < count; i++) {
+		auto extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+		if (extension && strcmp(extension, name) == 0)
+			return true;
+	}
+	return false;
+}
+
+// the driver can hand out program binaries and take them back
+static bool binaries() {
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	return formats > 0;
+}
+
+// one part of the text hashed, then a separator, so that moving text from one part to the next changes the hash
+static void mix(unsigned long long &hash, const char *data, size_t size) {
+	static const unsigned char SEPARATOR = 0xFF;
+
+	fnv1a(hash, data, size);
+	fnv1a(hash, &SEPARATOR, 1);
+}
+
+static void mix(unsigned long long &hash, const GLubyte *text) {
+	auto string = text ? reinterpret_cast<const char*>(text) : "";
+	mix(hash, string, strlen(string));
+}
+
+Shader::Shader(const GLchar* vertexPath, const GLchar* fragmentPath, bool wait)
+	: Program(0), vertexPath(vertexPath), fragmentPath(fragmentPath), hash(0),
+	vertex(0), fragment(0), pending(false), linked(false), fromCache(false) {
+
+	read();
+	start();
+
+	if (wait)
+		finish();
+}
+
+// load both files and hash them with the driver; FALSE if a file can't be read
+bool Shader::read() {
+	std::ifstream vShaderFile(vertexPath), fShaderFile(fragmentPath);
+
+	if (!vShaderFile || !fShaderFile) {
+		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
+		return false;
+	}
+
+	std::stringstream vShaderStream, fShaderStream;
+	vShaderStream << vShaderFile.rdbuf();
+	fShaderStream << fShaderFile.rdbuf();
+
+	vertexCode = vShaderStream.str();
+	fragmentCode = fShaderStream.str();
+
+	hash = FNV_OFFSET;
+	mix(hash, glGetString(GL_VENDOR));
+	mix(hash, glGetString(GL_RENDERER));
+	mix(hash, glGetString(GL_VERSION));
+	mix(hash, vertexCode.data(), vertexCode.size());
+	mix(hash, fragmentCode.data(), fragmentCode.size());
+
+	return true;
+}
+
+// load the cached binary, or compile and link without waiting for the result
+void Shader::start() {
+	pending = false;
+	linked = false;
+	fromCache = load();
+
+	if (fromCache) {
+		linked = true;
+		return;
+	}
+
+	auto vShaderCode = vertexCode.c_str();
+	auto fShaderCode = fragmentCode.c_str();
+
+	vertex = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(vertex, 1, &vShaderCode, nullptr);
+	glCompileShader(vertex);
+
+	fragment = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(fragment, 1, &fShaderCode, nullptr);
+	glCompileShader(fragment);
+
+	Program = glCreateProgram();
+	glAttachShader(Program, vertex);
+	glAttachShader(Program, fragment);
+	if (binaries())
+		glProgramParameteri(Program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(Program);
+
+	pending = true;
+}
+
+bool Shader::ready() const {
+	if (!pending)
+		return true;
+
+	// without the extension asking would wait, so the caller may as well finish()
+	static const auto parallel = hasExtension("GL_KHR_parallel_shader_compile");
+	if (!parallel)
+		return true;
+
+	GLint done = GL_FALSE;
+	glGetProgramiv(Program, GL_COMPLETION_STATUS_KHR, &done);
+	return done == GL_TRUE;
+}
+
+bool Shader::finish() {
+	if (!pending)
+		return linked;
+
+	GLint success;
+	GLchar infoLog[512];
+
+	glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
+	if (!success) {
+		glGetShaderInfoLog(vertex, 512, nullptr, infoLog);
+		std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+	}
+
+	glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
+	if (!success) {
+		glGetShaderInfoLog(fragment, 512, nullptr, infoLog);
+		std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+	}
+
+	glGetProgramiv(Program, GL_LINK_STATUS, &success);
+	if (!success) {
+		glGetProgramInfoLog(Program, 512, nullptr, infoLog);
+		std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+	}
+
+	glDetachShader(Program, vertex);
+	glDetachShader(Program, fragment);
+	glDeleteShader(vertex);
+	glDeleteShader(fragment);
+	vertex = fragment = 0;
+
+	pending = false;
+	linked = success == GL_TRUE;
+
+	if (linked)
+		save();
+	return linked;
+}
+
+bool Shader::reload() {
+	finish();
+
+	auto oldProgram = Program;
+	auto oldHash = hash;
+	auto oldLinked = linked, oldCache = fromCache;
+
+	if (!read() || (hash == oldHash && oldLinked))
+		return oldLinked;
+
+	start();
+	if (finish()) {
+		glDeleteProgram(oldProgram);
+		uniforms.clear();
+		return true;
+	}
+
+	glDeleteProgram(Program);
+	Program = oldProgram;
+	hash = oldHash;
+	linked = oldLinked;
+	fromCache = oldCache;
+	return false;
+}
+
+GLint Shader::uniform(const GLchar *name) {
+	for (auto &entry : uniforms)
+		if (entry.first == name)
+			return entry.second;
+
+	auto location = glGetUniformLocation(Program, name);
+	uniforms.push_back(std::make_pair(std::string(name), location));
+	return location;
+}
+
+std::string Shader::cachePath() const {
+	static const char DIGITS[] = "0123456789abcdef";
+	std::string name(16, '0');
+
+	for (int i = 0; i < 16; i++)
+		name[i] = DIGITS[(hash >> (60 - 4 * i)) & 0xF];
+
+	return cacheDirectory + "/" + name + ".bin";
+}
+
+// the file is MAGIC, the binary format and the binary; FALSE if there is none or the driver won't take it
+bool Shader::load() {
+	if (!binaries())
+		return false;
+
+	std::ifstream file(cachePath(), std::ios::binary | std::ios::ate);
+	if (!file)
+		return false;
+
+	auto size = static_cast<size_t>(file.tellg());
+	char magic[sizeof(MAGIC)];
+	GLenum format;
+
+	if (size <= sizeof(magic) + sizeof(format))
+		return false;
+
+	std::vector<char> binary(size - sizeof(magic) - sizeof(format));
+
+	file.seekg(0);
+	file.read(magic, sizeof(magic));
+	file.read(reinterpret_cast<char*>(&format), sizeof(format));
+	file.read(binary.data(), binary.size());
+
+	if (!file || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+		return false;
+
+	Program = glCreateProgram();
+	glProgramBinary(Program, format, binary.data(), static_cast<GLsizei>(binary.size()));
+
+	GLint success;
+	glGetProgramiv(Program, GL_LINK_STATUS, &success);
+	if (success)
+		return true;
+
+	glDeleteProgram(Program);
+	Program = 0;
+	return false;
+}
+
+void Shader::save() const {
+	if (!binaries())
+		return;
+
+	GLint length = 0;
+	glGetProgramiv(Program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	std::vector<char> binary(length);
+	GLenum format;
+	glGetProgramBinary(Program, length, &length, &format, binary.data());
+
+#ifdef _WIN32
+	_mkdir(cacheDirectory.c_str());
+#else
+	mkdir(cacheDirectory.c_str(), 0755);
+#endif
+
+	std::ofstream file(cachePath(), std::ios::binary | std::ios::trunc);
+	file.write(MAGIC, sizeof(MAGIC));
+	file.write(reinterpret_cast<const char*>(&format), sizeof(format));
+	file.write(binary.data(), length);
+
+	if (!file)
+		std::cout << "ERROR::SHADER::CACHE_NOT_WRITTEN " << cachePath() << std::endl;
+}
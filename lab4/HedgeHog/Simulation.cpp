@@ -0,0 +1,62 @@
+#include "Simulation.h"
+#include "Profiler.h"
+#include <chrono>
+
+Simulation::Simulation(const Level &level, unsigned seed) : keys(0), running(true) {
+	record.level = level;
+	record.seed = seed;
+	record.checksum = 0;
+
+	thread = std::thread(&Simulation::run, this);
+}
+
+Simulation::~Simulation() {
+	stop();
+}
+
+void Simulation::stop() {
+	running = false;
+	if (thread.joinable())
+		thread.join();
+
+	if (state)
+		record.checksum = state->checksum();
+}
+
+void Simulation::run() {
+	typedef std::chrono::steady_clock Clock;
+	auto tick = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(Game::TICK));
+	auto stall = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(0.25f));
+
+	Profiler::nameThread("simulation");
+	{
+		PROFILE_SCOPE("scatter");
+		state.reset(new Game(record.level, record.seed));
+		state->extract(frames.back());
+		frames.publish();
+	}
+
+	auto next = Clock::now() + tick;
+	while (running) {
+		std::this_thread::sleep_until(next);
+
+		// After a stall at most a quarter of a second's worth is made up
+		auto now = Clock::now();
+		if (now - next > stall)
+			next = now - stall;
+
+		{
+			PROFILE_SCOPE("ticks");
+			while (next <= now) {
+				auto held = keys.load(std::memory_order_relaxed);
+				state->step(held);
+				record.inputs.push_back(static_cast<unsigned char>(held));
+				next += tick;
+			}
+		}
+
+		PROFILE_SCOPE("extract");
+		state->extract(frames.back());
+		frames.publish();
+	}
+}
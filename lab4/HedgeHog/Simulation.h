@@ -0,0 +1,47 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "Game.h"
+#include "TripleBuffer.h"
+
+/*
+The game on a thread of its own, ticking in real time, so that it and the
+window's drawing overlap: a frame costs the longer of the two, not both.
+After every tick it publishes a Frame through a TripleBuffer; the window
+thread draws the newest one there is, at most a tick old. Keys go the
+other way through an atomic, and the ones each tick used are kept for a
+replay.
+The game is scattered on the thread too, so that it goes on while the
+window loads the rest
+*/
+class Simulation {
+public:
+	Simulation(const Level &level, unsigned seed);
+	~Simulation();
+
+	// the keys held now, from the window thread
+	void input(unsigned held) { keys.store(held, std::memory_order_relaxed); }
+
+	// the newest frame; FALSE, and the same one as before, if no tick ended since
+	bool update() { return frames.update(); }
+	const Frame &frame() const { return frames.front(); }
+
+	// wait for the thread to end; the game and the replay can be read after
+	void stop();
+
+	const Game &game() const { return *state; }
+	const Replay &replay() const { return record; }
+
+private:
+	std::unique_ptr<Game> state;
+	Replay record;
+
+	TripleBuffer<Frame> frames;
+	std::atomic<unsigned> keys;
+	std::atomic<bool> running;
+	std::thread thread;
+
+	void run();
+};
@@ -0,0 +1,124 @@
+#include "SpatialGrid.h"
+#include <algorithm>
+#include <cmath>
+
+SpatialGrid::SpatialGrid(float minX, float minY, float maxX, float maxY, float cellSize)
+	: minX(minX), minY(minY), cellSize(cellSize), count(0) {
+
+	columns = std::max(1, static_cast<int>(std::ceil((maxX - minX) / cellSize)));
+	rows = std::max(1, static_cast<int>(std::ceil((maxY - minY) / cellSize)));
+	cells.resize(static_cast<size_t>(columns) * rows);
+}
+
+int SpatialGrid::column(float x) const {
+	auto column = static_cast<int>(std::floor((x - minX) / cellSize));
+	return std::min(std::max(column, 0), columns - 1);
+}
+
+int SpatialGrid::row(float y) const {
+	auto row = static_cast<int>(std::floor((y - minY) / cellSize));
+	return std::min(std::max(row, 0), rows - 1);
+}
+
+void SpatialGrid::insert(int id, const glm::vec3 &position) {
+	Entry entry = { id, position.x, position.y };
+	cell(position).push_back(entry);
+	count++;
+}
+
+void SpatialGrid::remove(int id, const glm::vec3 &position) {
+	auto &entries = cell(position);
+	for (auto &entry : entries)
+		if (entry.id == id) {
+			entry = entries.back();
+			entries.pop_back();
+			count--;
+			return;
+		}
+}
+
+void SpatialGrid::renumber(int from, int to, const glm::vec3 &position) {
+	for (auto &entry : cell(position))
+		if (entry.id == from) {
+			entry.id = to;
+			return;
+		}
+}
+
+void SpatialGrid::query(const glm::vec3 &position, float radius, std::vector<int> &found) const {
+	auto radius2 = radius * radius;
+	auto firstColumn = column(position.x - radius), lastColumn = column(position.x + radius);
+	auto lastRow = row(position.y + radius);
+
+	for (auto r = row(position.y - radius); r <= lastRow; r++)
+		for (auto c = firstColumn; c <= lastColumn; c++)
+			for (auto &entry : cells[r * columns + c]) {
+				auto dx = entry.x - position.x, dy = entry.y - position.y;
+				if (dx * dx + dy * dy <= radius2)
+					found.push_back(entry.id);
+			}
+}
+
+bool SpatialGrid::any(const glm::vec3 &position, float radius) const {
+	auto radius2 = radius * radius;
+	auto firstColumn = column(position.x - radius), lastColumn = column(position.x + radius);
+	auto lastRow = row(position.y + radius);
+
+	for (auto r = row(position.y - radius); r <= lastRow; r++)
+		for (auto c = firstColumn; c <= lastColumn; c++)
+			for (auto &entry : cells[r * columns + c]) {
+				auto dx = entry.x - position.x, dy = entry.y - position.y;
+				if (dx * dx + dy * dy < radius2)
+					return true;
+			}
+	return false;
+}
+
+std::vector<glm::vec3> poissonDisk(float minX, float minY, float maxX, float maxY, float radius,
+	std::default_random_engine &engine) {
+
+	static const int TRIES = 30;
+	static const float PI = 3.14159265f;
+
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<glm::vec3> points;
+	std::vector<int> active;
+
+	// with cells as wide as radius, a point can only be too close to ones in the 3x3 cells round it
+	SpatialGrid grid(minX, minY, maxX, maxY, radius);
+
+	auto add = [&](const glm::vec3 &point) {
+		grid.insert(static_cast<int>(points.size()), point);
+		active.push_back(static_cast<int>(points.size()));
+		points.push_back(point);
+	};
+
+	add(glm::vec3(minX + (maxX - minX) * unit(engine), minY + (maxY - minY) * unit(engine), 0.0f));
+
+	while (!active.empty()) {
+		// a random active point, which stops being active once nothing fits round it
+		auto pick = static_cast<size_t>(unit(engine) * active.size()) % active.size();
+		auto centre = points[active[pick]];
+		auto placed = false;
+
+		for (auto i = 0; i < TRIES && !placed; i++) {
+			// uniform by area in the ring from radius to twice radius
+			auto angle = 2 * PI * unit(engine);
+			auto distance = radius * std::sqrt(1 + 3 * unit(engine));
+			auto point = glm::vec3(centre.x + distance * std::cos(angle), centre.y + distance * std::sin(angle), 0.0f);
+
+			if (point.x < minX || point.x > maxX || point.y < minY || point.y > maxY || grid.any(point, radius))
+				continue;
+
+			add(point);
+			placed = true;
+		}
+
+		if (!placed) {
+			active[pick] = active.back();
+			active.pop_back();
+		}
+	}
+
+	return points;
+}
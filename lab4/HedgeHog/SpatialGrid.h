@@ -0,0 +1,52 @@
+#pragma once
+#include <random>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/*
+Points by the square cell they are in, for finding every point near a
+position without looking at the rest. Cells are cellSize wide over the box
+given, and points outside it go to the nearest cell on its edge, so the box
+only has to cover most of them.
+A point is known by an id of the caller's, its index in the caller's array
+say; when the caller moves the last element over a removed one, renumber()
+keeps the grid in step
+*/
+class SpatialGrid {
+public:
+	SpatialGrid(float minX, float minY, float maxX, float maxY, float cellSize);
+
+	void insert(int id, const glm::vec3 &position);
+	void remove(int id, const glm::vec3 &position);
+	void renumber(int from, int to, const glm::vec3 &position);
+
+	// ids of the points at most radius away, appended to found
+	void query(const glm::vec3 &position, float radius, std::vector<int> &found) const;
+	bool any(const glm::vec3 &position, float radius) const;
+
+	int size() const { return count; }
+
+private:
+	struct Entry {
+		int id;
+		float x, y;
+	};
+
+	float minX, minY, cellSize;
+	int columns, rows, count;
+	std::vector<std::vector<Entry>> cells;
+
+	int column(float x) const;
+	int row(float y) const;
+	std::vector<Entry> &cell(const glm::vec3 &position) { return cells[row(position.y) * columns + column(position.x)]; }
+};
+
+/*
+Poisson-disk points in the box, none closer than radius to another: Bridson's
+algorithm, which tries up to 30 points round each new one until no more fit,
+in time linear in the points. They come in the order they were found,
+which spreads out from the first one
+*/
+std::vector<glm::vec3> poissonDisk(float minX, float minY, float maxX, float maxY, float radius,
+	std::default_random_engine &engine);
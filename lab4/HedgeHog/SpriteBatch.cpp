@@ -0,0 +1,100 @@
+#include "SpriteBatch.h"
+
+static const GLuint INSTANCE_ATTRIBUTE = 3;
+static const GLuint REGION_ATTRIBUTE = 4;
+
+SpriteBatch::SpriteBatch() : capacity(0) {
+	GLfloat vertices[] = {
+		// Positions          // Colors           // Texture Coords
+		1.0f,  1.0f, 0.0f,   1.0f, 0.0f, 0.0f,   1.0f, 1.0f, // Top Right
+		1.0f, -1.0f, 0.0f,   0.0f, 1.0f, 0.0f,   1.0f, 0.0f, // Bottom Right
+		-1.0f, -1.0f, 0.0f,   0.0f, 0.0f, 1.0f,   0.0f, 0.0f, // Bottom Left
+		-1.0f,  1.0f, 0.0f,   1.0f, 1.0f, 0.0f,   0.0f, 1.0f  // Top Left
+	};
+
+	GLuint indices[] = {
+		0, 1, 3,		  // First Triangle
+		1, 2, 3           // Second Triangle
+	};
+
+	glGenVertexArrays(1, &vertexArray);
+	glGenBuffers(1, &quadBuffer);
+	glGenBuffers(1, &indexBuffer);
+	glGenBuffers(1, &instanceBuffer);
+
+	glBindVertexArray(vertexArray);
+
+	glBindBuffer(GL_ARRAY_BUFFER, quadBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+	// Position attribute
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), static_cast<GLvoid*>(0));
+	glEnableVertexAttribArray(0);
+	// Color attribute
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), reinterpret_cast<GLvoid*>(3 * sizeof(GLfloat)));
+	glEnableVertexAttribArray(1);
+	// TexCoord attribute
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), reinterpret_cast<GLvoid*>(6 * sizeof(GLfloat)));
+	glEnableVertexAttribArray(2);
+
+	// Sprite and region attributes, one a sprite rather than one a vertex
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	glVertexAttribPointer(INSTANCE_ATTRIBUTE, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), static_cast<GLvoid*>(0));
+	glEnableVertexAttribArray(INSTANCE_ATTRIBUTE);
+	glVertexAttribDivisor(INSTANCE_ATTRIBUTE, 1);
+	glVertexAttribPointer(REGION_ATTRIBUTE, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), reinterpret_cast<GLvoid*>(4 * sizeof(GLfloat)));
+	glEnableVertexAttribArray(REGION_ATTRIBUTE);
+	glVertexAttribDivisor(REGION_ATTRIBUTE, 1);
+
+	glBindVertexArray(0);
+}
+
+void SpriteBatch::add(const TextureRegion &region, float x, float y, float width, float height) {
+	Instance instance = { x, y, width, height, region.u, region.v, region.width, region.height };
+	instances.push_back(instance);
+
+	if (runs.empty() || runs.back().first != region.texture)
+		runs.push_back(std::make_pair(region.texture, 0));
+	runs.back().second++;
+}
+
+void SpriteBatch::draw(RenderState &state) {
+	if (instances.empty())
+		return;
+
+	state.bindVertexArray(vertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+
+	/*
+	Grow the buffer to twice what is needed, so a growing crowd doesn't
+	reallocate every frame. Otherwise orphan it: the driver gives fresh
+	storage while last frame's draws still read the old one, instead of
+	stalling until they are done
+	*/
+	if (instances.size() > capacity)
+		capacity = 2 * instances.size();
+	glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(Instance), nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(Instance), instances.data());
+	state.count(3);
+
+	// GL 3.3 has no base instance, so each run points the attribute at its first sprite instead
+	size_t first = 0;
+	for (auto &run : runs) {
+		state.bindTexture(0, run.first);
+
+		glVertexAttribPointer(INSTANCE_ATTRIBUTE, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+			reinterpret_cast<GLvoid*>(first * sizeof(Instance)));
+		glVertexAttribPointer(REGION_ATTRIBUTE, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+			reinterpret_cast<GLvoid*>(first * sizeof(Instance) + 4 * sizeof(GLfloat)));
+		glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr, run.second);
+		state.count(3);
+
+		first += run.second;
+	}
+
+	instances.clear();
+	runs.clear();
+}
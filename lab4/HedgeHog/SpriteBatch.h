@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "RenderState.h"
+
+// part of a texture, in texture coordinates from its top left corner
+struct TextureRegion {
+	GLuint texture;
+	GLfloat u, v, width, height;
+};
+
+/*
+Sprites collected over a frame and drawn with one instanced draw per texture.
+Every sprite is the same quad, moved and scaled by its own instance
+attributes (location 3: x, y and the half width and height, negative to
+flip; location 4: its texture region), so no uniform is set between sprites.
+Sprites are drawn in the order they were added. The ones added one after
+another with the same texture make one run, and each run is one
+glDrawElementsInstanced
+*/
+class SpriteBatch {
+public:
+	// needs a current GL context
+	SpriteBatch();
+	~SpriteBatch() {}
+
+	void add(const TextureRegion &region, float x, float y, float width, float height);
+
+	// upload the frame's sprites, draw them and start collecting the next frame
+	void draw(RenderState &state);
+
+	int size() const { return static_cast<int>(instances.size()); }
+
+private:
+	struct Instance {
+		GLfloat x, y, width, height;
+		GLfloat u, v, regionWidth, regionHeight;
+	};
+
+	GLuint vertexArray, quadBuffer, indexBuffer, instanceBuffer;
+	size_t capacity; // instances the instance buffer has room for
+
+	std::vector<Instance> instances;
+	std::vector<std::pair<GLuint, int>> runs; // texture and number of sprites
+
+	SpriteBatch(const SpriteBatch &) = delete;
+	SpriteBatch &operator=(const SpriteBatch &) = delete;
+};
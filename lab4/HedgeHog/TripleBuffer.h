@@ -0,0 +1,44 @@
+#pragma once
+#include <atomic>
+
+/*
+A value handed from one thread that writes it to one that reads it,
+without locks and without either waiting for the other. The writer fills
+back() and publish()es it; the reader calls update() and reads front(),
+which is then the newest value published and stays as it is until the
+next update(). Values published in between are skipped, so the reader is
+at most one value behind.
+Three copies: the writer's, the reader's and the newest published one in
+the middle, swapped by index. The values are reused, so a vector in one
+keeps its memory
+*/
+template <typename T>
+class TripleBuffer {
+public:
+	TripleBuffer() : middle(1), frontIndex(0), backIndex(2) {}
+
+	T &back() { return values[backIndex]; }
+	const T &front() const { return values[frontIndex]; }
+
+	void publish() {
+		backIndex = middle.exchange(backIndex | FRESH, std::memory_order_acq_rel) & INDEX;
+	}
+
+	// FALSE, and front() as it was, if nothing was published since the last time
+	bool update() {
+		if (!(middle.load(std::memory_order_relaxed) & FRESH))
+			return false;
+		frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & INDEX;
+		return true;
+	}
+
+private:
+	static const unsigned INDEX = 3, FRESH = 4;
+
+	T values[3];
+	std::atomic<unsigned> middle; // index, and FRESH until the reader takes it
+	unsigned frontIndex, backIndex;
+
+	TripleBuffer(const TripleBuffer &) = delete;
+	TripleBuffer &operator=(const TripleBuffer &) = delete;
+};
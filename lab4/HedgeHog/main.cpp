@@ -2,8 +2,7 @@
 #include <iostream>
 
 //GLM
-#include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/type_ptr.hpp>
+#include <glm/glm.hpp>
 
 // GLEW
 #define GLEW_STATIC
@@ -12,169 +11,311 @@
 // GLFW
 #include <GLFW/glfw3.h>
 
-// Other Libs
-#include <SOIL/SOIL.h>
-
 // Other includes
 #include "Shader.h"
+#include "RenderState.h"
+#include "SpriteBatch.h"
+#include "Atlas.h"
+#include "Game.h"
+#include "Simulation.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
 #include <vector>
 #include <random>
 #include <ctime>
+#include <string>
 
 const GLchar* grass_pic = "grass.jpg";
 const GLchar* hedgehog_pic = "hedgehog.png";
 const GLchar* apple_pic = "apple.png";
 const GLchar* congrats_pic = "congrats.png";
 
-// Java Style
-struct Ratios {
-	static const double GRASS;
-	static const double HEDGEHOG;
-	static const double APPLE;
-};
-
-const double Ratios::GRASS = 1.0;
-const double Ratios::HEDGEHOG = 0.15;
-const double Ratios::APPLE = 0.075;
-
-enum DIRECTION {
-	FORWARD,
-	BACKWARD,
-	LEFT,
-	RIGHT
-};
-
 const auto DEF_POS = glm::vec3();
-const auto SPEED = 2.0f;
 const auto APPLE_NUM = 20;
-const glm::vec3 front = glm::vec3(0.0, 0.5, 0.0);
-const glm::vec3 right = glm::vec3(0.5, 0.0, 0.0);
 
-auto deltaTime = 0.0f;
-auto lastFrame = 0.0f;
-auto left = true;
-auto win = false;
+// a level of two million apples, for seeing the frame time stay the same however big it is
+const auto STRESS_CHUNKS = 64;
+const auto STRESS_APPLES = 512;
 
-std::vector<glm::vec3> applePositions;
+// Keys array to keep track of pressed keys, the window's user pointer
+struct Controls {
+	bool keys[1024];
+};
 
 // Window dimensions
 const GLuint WIDTH = 1000, HEIGHT = 750;
-glm::vec3 origin = glm::vec3();
-glm::vec3 hedgehogOrigin = glm::vec3();
-
-GLFWwindow* initialize();
-GLuint bindTexture(const GLchar* path);
-void useTexture(GLuint& texture, Shader& shader);
-void renderRectangle();
-void drawRectangle(glm::vec3 &position, const GLint transLoc, double ratio);
-void keyboard(DIRECTION direction, GLfloat deltaTime);
-void move();
+
+GLFWwindow* initialize(Controls &controls);
+unsigned input(const Controls &controls);
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode);
 
+int play(const Level &level, const char *recordPath, const char *tracePath);
+int replayGame(const char *path);
+int simulate(const Level &level, long long tickNumber, unsigned seed);
+
 // The MAIN function, from here we start the application and run the game loop
-int main() {
-	auto window = initialize();
-
-	// Build and compile our shader program
-	Shader shader("vertex.txt", "fragment.txt");
-
-	// Load and create a textures
-	auto apple = bindTexture(apple_pic);
-	auto grass = bindTexture(grass_pic);
-	auto hedgehog = bindTexture(hedgehog_pic);
-	auto congrats = bindTexture(congrats_pic);
-
-	std::default_random_engine dre;
-	dre.seed(time(nullptr));
-	std::uniform_real_distribution<double> dis(-0.9, 0.9);
-
-	// Generate apples
-	for (auto i = 0; i < APPLE_NUM; ++i) {
-		auto position = glm::vec3(dis(dre), dis(dre), 0.0);
-		
-		// Check if apples are not too close to each other and do not overlap
-		for (auto j = applePositions.begin(); j != applePositions.end(); ++j) {
-			if (distance(position, *j) < 0.2) {
-				position = glm::vec3(dis(dre), dis(dre), 0.0);
-				j = applePositions.begin();
-			}
-		}
+int main(int argc, char* argv[]) {
+	// play and keep the keys of every tick: HedgeHog record <file> [apples] [chunks], with chunks the apples are a chunk's
+	if (argc > 2 && std::string(argv[1]) == "record") {
+		auto appleNumber = argc > 3 ? atoi(argv[3]) : APPLE_NUM;
+		auto chunks = argc > 4 ? atoi(argv[4]) : 1;
+		return play(chunks > 1 ? Level::world(chunks, appleNumber) : Level::screen(appleNumber), argv[2], nullptr);
+	}
 
-		applePositions.push_back(position);
+	// play and write where the time of each frame went, for chrome://tracing: HedgeHog profile <file> [apples]
+	if (argc > 2 && std::string(argv[1]) == "profile")
+		return play(Level::screen(argc > 3 ? atoi(argv[3]) : APPLE_NUM), nullptr, argv[2]);
+
+	// a level of chunks by chunks screens that the screen follows the hedgehog over: HedgeHog world <chunks> [apples a chunk] [resident chunks]
+	if (argc > 2 && std::string(argv[1]) == "world") {
+		auto level = Level::world(atoi(argv[2]), argc > 3 ? atoi(argv[3]) : APPLE_NUM);
+		if (argc > 4)
+			level.residentChunks = atoi(argv[4]);
+		return play(level, nullptr, nullptr);
 	}
-	
-	// Game loop
-	while (!glfwWindowShouldClose(window)) {
 
-		// Count time of each frame to keep FPS stable
-		auto currentFrame = glfwGetTime();
-		deltaTime = currentFrame - lastFrame;
-		lastFrame = currentFrame;
+	// the biggest level, traced if a file is given: HedgeHog stress [trace file]
+	if (argc > 1 && std::string(argv[1]) == "stress")
+		return play(Level::world(STRESS_CHUNKS, STRESS_APPLES), nullptr, argc > 2 ? argv[2] : nullptr);
+
+	// play a recording again without a window and check it ends the same: HedgeHog replay <file>
+	if (argc > 2 && std::string(argv[1]) == "replay")
+		return replayGame(argv[2]);
+
+	// ticks a second of the game alone, on keys made up from the seed: HedgeHog headless <apples> <ticks> [seed] [chunks]
+	// with chunks, the apples are a chunk's
+	if (argc > 3 && std::string(argv[1]) == "headless") {
+		auto appleNumber = atoi(argv[2]);
+		auto chunks = argc > 5 ? atoi(argv[5]) : 1;
+		auto level = chunks > 1 ? Level::world(chunks, appleNumber) : Level::screen(appleNumber);
+		return simulate(level, atoll(argv[3]), argc > 4 ? atoi(argv[4]) : 1);
+	}
 
-		// Check if any events have been activiated (key pressed, mouse moved etc.) and call corresponding response functions
-		glfwPollEvents();
-		move();
+	// HedgeHog [apples] scatters that many apples instead of APPLE_NUM
+	return play(Level::screen(argc > 1 ? atoi(argv[1]) : APPLE_NUM), nullptr, nullptr);
+}
 
-		// Render
-		// Clear the colorbuffer
-		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
+int play(const Level &level, const char *recordPath, const char *tracePath) {
+	// From the start, so that the loading is in the trace too
+	Profiler::nameThread("window");
+	if (tracePath)
+		Profiler::start();
+
+	Controls controls = {};
+	auto window = initialize(controls);
+
+	// Binds go through it so that the ones that change nothing are skipped
+	RenderState renderState;
+
+	// Build and compile our shader program, the driver can do it while the sprites load
+	auto startTime = glfwGetTime();
+	Shader shader("vertex.txt", "fragment.txt", false);
+
+	// Decode the pictures on other threads into one texture, each no bigger than it is drawn
+	auto drawn = [](double ratio, GLuint size) { return static_cast<int>(std::ceil(ratio * size)); };
+	Atlas atlas({
+		{ apple_pic, drawn(Ratios::APPLE, WIDTH), drawn(Ratios::APPLE, HEIGHT) },
+		{ grass_pic, drawn(Ratios::GRASS, WIDTH), drawn(Ratios::GRASS, HEIGHT) },
+		{ hedgehog_pic, drawn(Ratios::HEDGEHOG, WIDTH), drawn(Ratios::HEDGEHOG, HEIGHT) },
+		{ congrats_pic, drawn(Ratios::GRASS, WIDTH), drawn(Ratios::GRASS, HEIGHT) }
+	});
+
+	// Every sprite of a frame goes through it
+	SpriteBatch batch;
+
+	// Generate apples and start the game on its own thread, the seed is all a replay needs to scatter them the same again
+	Simulation simulation(level, static_cast<unsigned>(time(nullptr)));
+
+	{
+		PROFILE_SCOPE("wait for the sprites and the shader");
+		atlas.finish();
+		shader.finish();
+	}
+	std::cout << "Sprites " << (atlas.cached() ? "loaded from the cache" : "decoded") << " into a "
+		<< atlas.width() << "x" << atlas.height() << " atlas, ready in " << 1000 * (glfwGetTime() - startTime) << " ms" << std::endl;
 
-		auto transLoc = glGetUniformLocation(shader.Program, "transform");
+	// by Game::Sprite
+	std::vector<TextureRegion> regions;
+	for (auto i = 0; i < 4; i++)
+		regions.push_back(atlas.region(i));
 
-		// Draw background
-		useTexture(grass, shader);
-		drawRectangle(origin, transLoc, Ratios::GRASS);
+	// Every sprite samples unit 0, so the sampler is set once
+	renderState.useProgram(shader.Program);
+	glUniform1i(shader.uniform("ourTexture"), 0);
 
-		// Draw apples 
-		useTexture(apple, shader);
+	auto frames = 0;
+	auto lastTitle = glfwGetTime();
 
-		std::vector<glm::vec3> newPositions;
-		for (auto i : applePositions) {
-			// Check if hedgehog is close to apple, if so, remove
-			if (distance(i, hedgehogOrigin) > 0.15)
-				newPositions.push_back(i);
-			drawRectangle(i, transLoc, Ratios::APPLE);
-		}
+	// Game loop, the game itself ticks on the simulation's thread meanwhile
+	while (!glfwWindowShouldClose(window)) {
+		auto currentFrame = glfwGetTime();
 
-		// Update apple vector
-		applePositions = newPositions;
+		// Check if any events have been activiated (key pressed, mouse moved etc.) and call corresponding response functions
+		{
+			PROFILE_SCOPE("poll");
+			glfwPollEvents();
+			simulation.input(input(controls));
+		}
 
-		if (applePositions.empty())
-			win = true;
+		// R reads the shader files again
+		if (controls.keys[GLFW_KEY_R]) {
+			shader.reload();
+			renderState.useProgram(shader.Program);
+			glUniform1i(shader.uniform("ourTexture"), 0);
+			controls.keys[GLFW_KEY_R] = false;
+		}
 
-		// Draw hedgehog
-		useTexture(hedgehog, shader);
-		drawRectangle(hedgehogOrigin, transLoc, Ratios::HEDGEHOG);
+		// Render
+		// Clear the colorbuffer
+		Profiler::gpuBegin("frame");
+		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		renderState.count(2);
+
+		// Draw the newest tick: the grass, the apples, the hedgehog and the victory picture once it is won, those on the screen
+		{
+			PROFILE_SCOPE("batch");
+			simulation.update();
+			for (auto &sprite : simulation.frame().sprites)
+				batch.add(regions[sprite.sprite], sprite.x, sprite.y, sprite.width, sprite.height);
+		}
 
-		// Victory picture
-		if (win == true) {
-			useTexture(congrats, shader);
-			drawRectangle(origin, transLoc, Ratios::GRASS);
+		// One draw for each texture
+		auto sprites = batch.size();
+		{
+			PROFILE_SCOPE("draw");
+			renderState.useProgram(shader.Program);
+			batch.draw(renderState);
 		}
+		Profiler::gpuEnd();
 
 		// Swap the screen buffers
-		glfwSwapBuffers(window);
+		{
+			PROFILE_SCOPE("swap");
+			glfwSwapBuffers(window);
+		}
+		renderState.newFrame();
+		Profiler::count("sprites", sprites);
+		Profiler::count("culled sprites", simulation.frame().culled);
+		Profiler::count("GL calls", renderState.calls());
+		Profiler::count("skipped binds", renderState.skipped());
+		Profiler::collect();
+		Profiler::frame();
+
+		// Once a second the title shows the frame rate, the slowest frames and what a frame costs in GL calls
+		frames++;
+		if (currentFrame - lastTitle >= 1.0) {
+			auto title = "HedgeHog - " + std::to_string(frames) + " fps, " + std::to_string(std::lround(Profiler::percentile(0.99))) + " ms p99, "
+				+ std::to_string(sprites) + " sprites, " + std::to_string(renderState.calls())
+				+ " GL calls a frame, " + std::to_string(renderState.skipped()) + " skipped";
+			glfwSetWindowTitle(window, title.c_str());
+
+			frames = 0;
+			lastTitle = currentFrame;
+		}
 	}
 	// Terminate GLFW, clearing any resources allocated by GLFW.
 	glfwTerminate();
+	simulation.stop();
+
+	if (tracePath) {
+		Profiler::stop();
+		std::cout << Profiler::histogram();
+		if (!Profiler::write(tracePath))
+			return 1;
+		std::cout << "Trace written to " << tracePath << std::endl;
+	}
+
+	if (recordPath) {
+		auto &replay = simulation.replay();
+		if (!replay.save(recordPath))
+			return 1;
+		std::cout << "Recorded " << replay.inputs.size() << " ticks to " << recordPath
+			<< ", checksum " << std::hex << replay.checksum << std::dec << std::endl;
+	}
+	return 0;
+}
+
+int replayGame(const char *path) {
+	Replay replay;
+	if (!replay.load(path))
+		return 1;
+
+	auto start = std::chrono::steady_clock::now();
+	Game game(replay.level, replay.seed);
+	for (auto held : replay.inputs)
+		game.step(held);
+	auto time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	auto checksum = game.checksum();
+	std::cout << "Replayed " << replay.inputs.size() << " ticks in " << time << " ms, checksum " << std::hex << checksum;
+	if (checksum == replay.checksum)
+		std::cout << std::dec << ": the same as when recorded" << std::endl;
+	else
+		std::cout << ", recorded " << replay.checksum << std::dec << ": THE REPLAY DIFFERS" << std::endl;
+
+	return checksum == replay.checksum ? 0 : 1;
 }
 
-// Keys array to keep track of pressed keys
-bool keys[1024] = {};
+int simulate(const Level &level, long long tickNumber, unsigned seed) {
+	auto start = std::chrono::steady_clock::now();
+	Game game(level, seed);
+	auto ready = std::chrono::steady_clock::now();
+
+	// a walk that takes new keys, maybe a diagonal or none, every half a second; a frame is extracted every other tick, as at 60 fps
+	std::minstd_rand walk(seed);
+	unsigned held = 0;
+	Frame frame;
+	std::chrono::steady_clock::duration extracting(0);
+	long long frames = 0, drawn = 0;
+	for (long long i = 0; i < tickNumber; i++) {
+		if (i % 60 == 0)
+			held = walk() % 16;
+		game.step(held);
+
+		if (i % 2 == 0) {
+			auto extractStart = std::chrono::steady_clock::now();
+			game.extract(frame);
+			extracting += std::chrono::steady_clock::now() - extractStart;
+			drawn += frame.sprites.size();
+			frames++;
+		}
+	}
+
+	auto end = std::chrono::steady_clock::now();
+	auto setup = std::chrono::duration<double, std::milli>(ready - start).count();
+	auto time = std::chrono::duration<double>(end - ready - extracting).count();
+	auto extract = std::chrono::duration<double, std::micro>(extracting).count();
+
+	auto appleNumber = static_cast<long long>(level.chunks) * level.chunks * level.applesPerChunk;
+	std::cout << appleNumber << " apples in " << level.chunks << "x" << level.chunks << " chunks scattered in " << setup << " ms, "
+		<< tickNumber << " ticks in " << 1000 * time << " ms: " << tickNumber / time << " ticks a second" << std::endl;
+	std::cout << frames << " frames extracted, " << (frames ? extract / frames : 0.0) << " us and " << (frames ? drawn / frames : 0)
+		<< " sprites each, " << game.residentChunks() << " chunks resident" << std::endl;
+	std::cout << game.applesLeft() << " apples left" << (game.won() ? ", won" : "")
+		<< ", checksum " << std::hex << game.checksum() << std::dec << std::endl;
+	return 0;
+}
 
 // Is called whenever a key is pressed/released via GLFW
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode) {
 	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, GL_TRUE);
 
+	auto controls = static_cast<Controls*>(glfwGetWindowUserPointer(window));
+	if (key < 0 || key >= 1024)
+		return;
+
 	if (action == GLFW_PRESS)
-		keys[key] = true;
+		controls->keys[key] = true;
 	if (action == GLFW_RELEASE)
-		keys[key] = false;
+		controls->keys[key] = false;
 }
 
-GLFWwindow* initialize() {
+GLFWwindow* initialize(Controls &controls) {
 	glfwInit();
 	// Set all the required options for GLFW
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -187,6 +328,7 @@ GLFWwindow* initialize() {
 	glfwMakeContextCurrent(window);
 
 	// Set the required callback functions
+	glfwSetWindowUserPointer(window, &controls);
 	glfwSetKeyCallback(window, key_callback);
 
 	// Set this to true so GLEW knows to use a modern approach to retrieving function pointers and extensions
@@ -200,138 +342,17 @@ GLFWwindow* initialize() {
 	return window;
 }
 
-GLuint bindTexture(const GLchar* path) {
-	GLuint textureID;
-	glGenTextures(1, &textureID);
-	int width, height;
-	auto image = SOIL_load_image(path, &width, &height, nullptr, SOIL_LOAD_RGBA);
-
-	// Assign texture to ID
-	glBindTexture(GL_TEXTURE_2D, textureID);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-	glGenerateMipmap(GL_TEXTURE_2D);
-
-	// Parameters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glBindTexture(GL_TEXTURE_2D, 0);
-	SOIL_free_image_data(image);
-
-	return textureID;
-}
-
-void useTexture(GLuint& texture, Shader& shader) {
-	// Bind Textures using texture units
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, texture);
-	glUniform1i(glGetUniformLocation(shader.Program, "ourTexture"), 0);
-	
-	// Activate shader
-	shader.Use();
-}
-
-// Set up vertex data (and buffer(s)) and attribute pointers
-GLuint rectangleVAO = 0;
-GLuint rectangleVBO = 0;
-GLuint rectangleEBO = 0;
-
-void renderRectangle() {
-	if (rectangleVAO == 0) {
-		GLfloat vertices[] = {
-			// Positions          // Colors           // Texture Coords
-			1.0f,  1.0f, 0.0f,   1.0f, 0.0f, 0.0f,   1.0f, 1.0f, // Top Right
-			1.0f, -1.0f, 0.0f,   0.0f, 1.0f, 0.0f,   1.0f, 0.0f, // Bottom Right
-			-1.0f, -1.0f, 0.0f,   0.0f, 0.0f, 1.0f,   0.0f, 0.0f, // Bottom Left
-			-1.0f,  1.0f, 0.0f,   1.0f, 1.0f, 0.0f,   0.0f, 1.0f  // Top Left 
-		};
-
-		GLuint indices[] = {  // Note that we start from 0!
-			0, 1, 3,		  // First Triangle
-			1, 2, 3           // Second Triangle
-		};
-
-		glGenVertexArrays(1, &rectangleVAO);
-		glGenBuffers(1, &rectangleVBO);
-		glGenBuffers(1, &rectangleEBO);
-
-		glBindVertexArray(rectangleVAO);
-
-		glBindBuffer(GL_ARRAY_BUFFER, rectangleVBO);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, rectangleEBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-		// Position attribute
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), static_cast<GLvoid*>(0));
-		glEnableVertexAttribArray(0);
-		// Color attribute
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), reinterpret_cast<GLvoid*>(3 * sizeof(GLfloat)));
-		glEnableVertexAttribArray(1);
-		// TexCoord attribute
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), reinterpret_cast<GLvoid*>(6 * sizeof(GLfloat)));
-		glEnableVertexAttribArray(2);
-
-		glBindVertexArray(0); // Unbind VAO
-	}
-
-	// Render Rectangle
-	glBindVertexArray(rectangleVAO);
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
-	glBindVertexArray(0);
-}
-
-void move() {
+// The keys held now, as the game takes them
+unsigned input(const Controls &controls) {
+	auto &keys = controls.keys;
+	unsigned held = 0;
 	if (keys[GLFW_KEY_W] == true)
-		keyboard(FORWARD, deltaTime);
+		held |= Game::FORWARD;
 	if (keys[GLFW_KEY_S] == true)
-		keyboard(BACKWARD, deltaTime);
+		held |= Game::BACKWARD;
 	if (keys[GLFW_KEY_A] == true)
-		keyboard(LEFT, deltaTime);
+		held |= Game::LEFT;
 	if (keys[GLFW_KEY_D] == true)
-		keyboard(RIGHT, deltaTime);
-}
-
-void keyboard(DIRECTION direction, GLfloat deltaTime) {
-	auto velocity = SPEED * deltaTime;
-
-	if (direction == FORWARD)
-		hedgehogOrigin += front * velocity;
-	if (direction == BACKWARD)
-		hedgehogOrigin -= front * velocity;
-
-	// if hedgehog changes direction from left to right
-	// or vice versa flip the texture horizontally
-	if (direction == LEFT) {
-		hedgehogOrigin -= right * velocity;
-		left = true;
-	}
-	if (direction == RIGHT) {
-		left = false;
-		hedgehogOrigin += right * velocity;
-	}
-}
-
-void drawRectangle(glm::vec3 &position, const GLint transLoc, double ratio) {
-
-	// Wrap the screen
-	if (position.y > 1 || position.y < -1 )
-		position.y = -position.y;
-	if (position.x > 1 || position.x < -1)
-		position.x = -position.x;
-
-	// Transform matrix for changing position of a hedgehog
-	glm::mat4 transform;
-	transform = translate(transform, position);
-
-	// If hedgehog changes direction change size of texture respectively
-	if (ratio == Ratios::HEDGEHOG && left == false)
-		transform = scale(transform, glm::vec3(-ratio, ratio, 0.0));
-	else 
-		transform = scale(transform, glm::vec3(ratio));	
-
-	glUniformMatrix4fv(transLoc, 1, GL_FALSE, value_ptr(transform));
-	renderRectangle();
+		held |= Game::RIGHT;
+	return held;
 }
@@ -0,0 +1,161 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "PriorityQueue.h"
+
+/*
+A PriorityQueue that knows where each element is: push() gives back a
+handle, and the element can be changed or taken out through it at any
+time, sifting it from where it is in O(log n), with no rebuild.
+Every move of a sift writes the element's new place by its handle, so the
+handles stay good however the heap reorders. Once an element leaves, pop
+or erase, its handle is free and may be given to a later push; until
+then contains() says false for it.
+Elements are kept next to their handles, so a sift reads one array
+*/
+template <typename T, typename Compare = std::less<T>, size_t Arity = 4>
+class IndexedHeap {
+	static_assert(Arity >= 2, "a heap node needs two children at least");
+
+public:
+	typedef unsigned Handle;
+
+	IndexedHeap() {}
+	explicit IndexedHeap(const Compare &compare) : compare(compare) {}
+
+	bool empty() const { return heap.empty(); }
+	size_t size() const { return heap.size(); }
+
+	const T &top() const { return heap.front().value; }
+	Handle topHandle() const { return heap.front().handle; }
+
+	Handle push(const T &value) { return place(T(value)); }
+	Handle push(T &&value) { return place(std::move(value)); }
+
+	template <typename... Args>
+	Handle emplace(Args &&... args) { return place(T(std::forward<Args>(args)...)); }
+
+	bool contains(Handle handle) const { return handle < positions.size() && positions[handle] != NONE; }
+
+	const T &operator[](Handle handle) const { return heap[positions[handle]].value; }
+
+	// a new value for the element, sifted up or down from where it is
+	void update(Handle handle, T value) {
+		auto index = positions[handle];
+		auto up = compare(heap[index].value, value);
+		heap[index].value = std::move(value);
+
+		if (up)
+			siftUp(index);
+		else
+			siftDown(index);
+	}
+
+	void pop() { erase(heap.front().handle); }
+
+	// the top moved out, and popped
+	T take() {
+		T value = std::move(heap.front().value);
+		pop();
+		return value;
+	}
+
+	// the last element into the hole left, sifted whichever way it belongs
+	void erase(Handle handle) {
+		auto index = positions[handle];
+		auto last = heap.size() - 1;
+
+		positions[handle] = NONE;
+		freeHandles.push_back(handle);
+
+		if (index != last) {
+			auto up = compare(heap[index].value, heap[last].value);
+			heap[index] = std::move(heap[last]);
+			positions[heap[index].handle] = index;
+			heap.pop_back();
+
+			if (up)
+				siftUp(index);
+			else
+				siftDown(index);
+		} else {
+			heap.pop_back();
+		}
+	}
+
+	void clear() {
+		heap.clear();
+		positions.clear();
+		freeHandles.clear();
+	}
+
+private:
+	static const size_t NONE = ~static_cast<size_t>(0);
+
+	struct Node {
+		T value;
+		Handle handle;
+	};
+
+	std::vector<Node, CacheAligned<Node>> heap;
+	std::vector<size_t> positions; // in heap, by handle; NONE for a free handle
+	std::vector<Handle> freeHandles;
+	Compare compare;
+
+	static size_t parent(size_t index) { return (index - 1) / Arity; }
+	static size_t firstChild(size_t index) { return Arity * index + 1; }
+
+	Handle place(T &&value) {
+		Handle handle;
+		if (freeHandles.empty()) {
+			handle = static_cast<Handle>(positions.size());
+			positions.push_back(heap.size());
+		} else {
+			handle = freeHandles.back();
+			freeHandles.pop_back();
+			positions[handle] = heap.size();
+		}
+
+		heap.push_back({ std::move(value), handle });
+		siftUp(heap.size() - 1);
+		return handle;
+	}
+
+	void siftUp(size_t index) {
+		if (index == 0 || !compare(heap[parent(index)].value, heap[index].value))
+			return;
+
+		Node node = std::move(heap[index]);
+		do {
+			heap[index] = std::move(heap[parent(index)]);
+			positions[heap[index].handle] = index;
+			index = parent(index);
+		} while (index > 0 && compare(heap[parent(index)].value, node.value));
+
+		heap[index] = std::move(node);
+		positions[heap[index].handle] = index;
+	}
+
+	void siftDown(size_t index) {
+		Node node = std::move(heap[index]);
+		for (size_t first; (first = firstChild(index)) < heap.size();) {
+			auto last = std::min(first + Arity, heap.size());
+			auto child = first;
+			for (auto other = first + 1; other < last; other++)
+				child = compare(heap[child].value, heap[other].value) ? other : child;
+
+			if (!compare(node.value, heap[child].value))
+				break;
+			heap[index] = std::move(heap[child]);
+			positions[heap[index].handle] = index;
+			index = child;
+		}
+
+		heap[index] = std::move(node);
+		positions[heap[index].handle] = index;
+	}
+};
@@ -0,0 +1,120 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "PriorityQueue.h"
+
+/*
+A priority queue that many threads push to and pop from at once without
+all of them waiting on one lock (a MultiQueue). The elements are spread over
+shards, each a PriorityQueue under its own lock, and there are more shards
+than threads. A push goes to a random shard. A pop looks at the tops of
+`choices` random shards and takes the greatest of them, so it returns one
+of the greatest elements, not always the greatest.
+How relaxed it is depends on the shard count and the choices. With more
+shards, threads wait on each other less, but a pop may land further from
+the top. With more choices, pops get closer to the top again, at the cost
+of a lock more each. One shard is a PriorityQueue under a lock.
+A busy shard is skipped for another rather than waited on. Each shard has
+cache lines of its own, and each thread picks shards with a random engine
+of its own, so threads working in different shards share nothing
+*/
+template <typename T, typename Compare = std::less<T>, size_t Arity = 4>
+class MultiQueue {
+public:
+	explicit MultiQueue(size_t shardNumber, size_t choices = 2, const Compare &compare = Compare())
+		: shards(std::max<size_t>(shardNumber, 1)), choices(std::max<size_t>(choices, 1)), compare(compare) {
+
+		for (auto &shard : shards)
+			shard.queue = Queue(compare);
+	}
+
+	size_t shardNumber() const { return shards.size(); }
+
+	void push(T value) {
+		for (;;) {
+			auto &shard = shards[pick()];
+			std::unique_lock<std::mutex> lock(shard.lock, std::try_to_lock);
+			if (!lock.owns_lock())
+				continue;
+
+			shard.queue.push(std::move(value));
+			shard.size.store(shard.queue.size(), std::memory_order_relaxed);
+			return;
+		}
+	}
+
+	// FALSE only once every shard has been seen empty
+	bool tryPop(T &value) {
+		for (auto attempt = 0; attempt < ATTEMPTS; attempt++) {
+			// the greatest top of the shards chosen that weren't empty or busy, its lock still held
+			Shard *best = nullptr;
+			std::unique_lock<std::mutex> bestLock;
+
+			for (size_t i = 0; i < choices; i++) {
+				auto &shard = shards[pick()];
+				if (&shard == best || shard.size.load(std::memory_order_relaxed) == 0)
+					continue;
+
+				std::unique_lock<std::mutex> lock(shard.lock, std::try_to_lock);
+				if (!lock.owns_lock() || shard.queue.empty())
+					continue;
+
+				if (!best || compare(best->queue.top(), shard.queue.top())) {
+					best = &shard;
+					bestLock = std::move(lock);
+				}
+			}
+
+			if (best) {
+				value = best->queue.take();
+				best->size.store(best->queue.size(), std::memory_order_relaxed);
+				return true;
+			}
+		}
+
+		// Nearly empty, as far as the random picks go: every shard in turn
+		for (auto &shard : shards) {
+			if (shard.size.load(std::memory_order_relaxed) == 0)
+				continue;
+
+			std::lock_guard<std::mutex> lock(shard.lock);
+			if (!shard.queue.empty()) {
+				value = shard.queue.take();
+				shard.size.store(shard.queue.size(), std::memory_order_relaxed);
+				return true;
+			}
+		}
+		return false;
+	}
+
+private:
+	static const int ATTEMPTS = 8;
+
+	typedef PriorityQueue<T, Compare, std::vector<T, CacheAligned<T>>, Arity> Queue;
+
+	// the size read without the lock, to skip an empty shard without taking it
+	struct alignas(64) Shard {
+		std::mutex lock;
+		Queue queue;
+		std::atomic<size_t> size;
+
+		Shard() : size(0) {}
+	};
+
+	std::vector<Shard, CacheAligned<Shard>> shards;
+	size_t choices;
+	Compare compare;
+
+	size_t pick() const {
+		static thread_local std::minstd_rand engine(static_cast<unsigned>(std::hash<std::thread::id>()(std::this_thread::get_id())));
+		return engine() % shards.size();
+	}
+};
@@ -0,0 +1,183 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <utility>
+#include <vector>
+
+/*
+Memory for a container aligned to a cache line, so that the first node of
+a heap starts one, and a group of children that fits in a line is in as
+few lines as it can be
+*/
+template <typename T, size_t Alignment = 64>
+struct CacheAligned {
+	typedef T value_type;
+
+	template <typename U>
+	struct rebind {
+		typedef CacheAligned<U, Alignment> other;
+	};
+
+	CacheAligned() {}
+	template <typename U>
+	CacheAligned(const CacheAligned<U, Alignment> &) {}
+
+	// the block asked for, the pointer to free it by just before what is handed out
+	T *allocate(size_t n) {
+		auto block = static_cast<char*>(::operator new(n * sizeof(T) + Alignment + sizeof(void*)));
+		auto address = reinterpret_cast<uintptr_t>(block + sizeof(void*));
+		auto aligned = reinterpret_cast<char*>((address + Alignment - 1) & ~static_cast<uintptr_t>(Alignment - 1));
+		reinterpret_cast<void**>(aligned)[-1] = block;
+		return reinterpret_cast<T*>(aligned);
+	}
+
+	void deallocate(T *pointer, size_t) {
+		::operator delete(reinterpret_cast<void**>(pointer)[-1]);
+	}
+};
+
+template <typename T, typename U, size_t Alignment>
+bool operator==(const CacheAligned<T, Alignment> &, const CacheAligned<U, Alignment> &) { return true; }
+
+template <typename T, typename U, size_t Alignment>
+bool operator!=(const CacheAligned<T, Alignment> &, const CacheAligned<U, Alignment> &) { return false; }
+
+/*
+A max-heap of any type: top() is the greatest element by Compare, as with
+Heap and std::priority_queue. Elements are moved into place and out again,
+never copied, so a heavy record costs what moving it does, not a copy of
+everything it holds on every level it sifts through.
+Sifting doesn't swap: the element is held aside and the ones in its way
+move into the hole it leaves, one move a level instead of three. pop()
+walks the hole from the root down to a leaf along the greater children
+without comparing them to the last element, which is then put in the hole
+and sifted up, a level or two at most; the last element belongs near the
+bottom anyway, and this takes about half the comparisons (Floyd's trick).
+Each node has Arity children: 4 or 8 make the heap shallower, and the
+children of a node lie side by side, so a level costs a cache line or so
+instead of a miss.
+Container is a random access sequence, a vector or a deque; elements()
+shows it in heap order
+*/
+template <typename T, typename Compare = std::less<T>, typename Container = std::vector<T, CacheAligned<T>>, size_t Arity = 2>
+class PriorityQueue {
+	static_assert(Arity >= 2, "a heap node needs two children at least");
+
+public:
+	typedef T value_type;
+	typedef Compare value_compare;
+	typedef Container container_type;
+
+	static const size_t ARITY = Arity;
+
+	PriorityQueue() {}
+	explicit PriorityQueue(const Compare &compare) : compare(compare) {}
+
+	// takes the elements as they are and builds the heap over them, in linear time
+	PriorityQueue(const Compare &compare, Container &&elements) : heap(std::move(elements)), compare(compare) {
+		if (heap.size() > 1)
+			for (auto i = parent(heap.size() - 1) + 1; i-- > 0;)
+				siftDown(i);
+	}
+
+	bool empty() const { return heap.empty(); }
+	size_t size() const { return heap.size(); }
+
+	const T &top() const { return heap.front(); }
+
+	void push(const T &value) {
+		heap.push_back(value);
+		siftUp(heap.size() - 1);
+	}
+
+	void push(T &&value) {
+		heap.push_back(std::move(value));
+		siftUp(heap.size() - 1);
+	}
+
+	// made in place at the end of the container, then sifted up
+	template <typename... Args>
+	void emplace(Args &&... args) {
+		heap.emplace_back(std::forward<Args>(args)...);
+		siftUp(heap.size() - 1);
+	}
+
+	void pop() {
+		if (heap.size() > 1)
+			fillRoot();
+		heap.pop_back();
+	}
+
+	// the top moved out, and popped
+	T take() {
+		T value = std::move(heap.front());
+		pop();
+		return value;
+	}
+
+	void clear() { heap.clear(); }
+
+	const Container &elements() const { return heap; }
+
+private:
+	Container heap;
+	Compare compare;
+
+	static size_t parent(size_t index) { return (index - 1) / Arity; }
+	static size_t firstChild(size_t index) { return Arity * index + 1; }
+
+	// the greatest of the children from first on that are before end, of which there is one at least
+	size_t greatestChild(size_t first, size_t end) const {
+		auto greatest = first;
+		if (first + Arity <= end) {
+			// a full node, a loop of a known length the compiler unrolls
+			for (size_t i = 1; i < Arity; i++)
+				greatest = compare(heap[greatest], heap[first + i]) ? first + i : greatest;
+		} else {
+			for (auto child = first + 1; child < end; child++)
+				greatest = compare(heap[greatest], heap[child]) ? child : greatest;
+		}
+		return greatest;
+	}
+
+	void siftUp(size_t index) {
+		if (index == 0 || !compare(heap[parent(index)], heap[index]))
+			return;
+
+		T value = std::move(heap[index]);
+		do {
+			heap[index] = std::move(heap[parent(index)]);
+			index = parent(index);
+		} while (index > 0 && compare(heap[parent(index)], value));
+		heap[index] = std::move(value);
+	}
+
+	void siftDown(size_t index) {
+		T value = std::move(heap[index]);
+		for (size_t first; (first = firstChild(index)) < heap.size();) {
+			auto child = greatestChild(first, heap.size());
+			if (!compare(value, heap[child]))
+				break;
+			heap[index] = std::move(heap[child]);
+			index = child;
+		}
+		heap[index] = std::move(value);
+	}
+
+	// the root's hole down to a leaf, the last element into it and up; the last slot is then left to pop
+	void fillRoot() {
+		auto last = heap.size() - 1;
+		size_t index = 0;
+		for (size_t first; (first = firstChild(index)) < last;) {
+			auto child = greatestChild(first, last);
+			heap[index] = std::move(heap[child]);
+			index = child;
+		}
+
+		heap[index] = std::move(heap[last]);
+		siftUp(index);
+	}
+};
@@ -1,6 +1,23 @@
 // lab 5 (a tree based on list)
 #include <iostream>
 #include <vector>
+#include <string>
+#include <chrono>
+#include <queue>
+#include <random>
+#include <cstdlib>
+#include <cmath>
+#include <iomanip>
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <limits>
+
+#include "PriorityQueue.h"
+#include "IndexedHeap.h"
+#include "MultiQueue.h"
 
 class List {
 	std::vector<int> array;
@@ -12,6 +29,7 @@ public:
 
 	int sizeOfArray() { return array.size(); }
 	int byIndex(int ind) { return array[ind]; }
+	void set(int ind, int key) { array[ind] = key; }
 	void swap(int first, int second) { std::swap(array[first], array[second]); }
 };
 
@@ -60,26 +78,31 @@ public:
 
 // fix heap properties (after insert/remove)
 void Heap::maxHeapify(int index) {
-	auto left = 2 * index + 1; // left child's index
-	auto right = 2 * index + 2; // right child's index
 	auto len = list.sizeOfArray();
-	int largest;
+	if (index >= len)
+		return;
 
-	// find the largest and swap with current (if current != largest)
-	// then call this function recursive
+	// hold the key aside and move the larger child up into its place while
+	// that child is larger than the key, then put the key in the hole left
 
-	if (left < len && list.byIndex(left) > list.byIndex(index))
-		largest = left;
-	else
-		largest = index;
+	auto key = list.byIndex(index);
+	while (true) {
+		auto left = 2 * index + 1; // left child's index
+		auto right = 2 * index + 2; // right child's index
+		if (left >= len)
+			break;
 
-	if (right < len && list.byIndex(right) > list.byIndex(index))
-		largest = right;
+		auto largest = left;
+		if (right < len && list.byIndex(right) > list.byIndex(largest))
+			largest = right;
+
+		if (list.byIndex(largest) <= key)
+			break;
 
-	if (largest != index) {
-		list.swap(index, largest);
-		maxHeapify(largest);
+		list.set(index, list.byIndex(largest));
+		index = largest;
 	}
+	list.set(index, key);
 }
 
 void Heap::buildMaxHeap() {
@@ -101,7 +124,7 @@ bool Heap::remove() {
 	if (len == 0)
 		return false;
 
-	list.swap(0, len - 1);
+	list.set(0, list.byIndex(len - 1));
 	list.remove();
 	maxHeapify(0);
 
@@ -148,7 +171,405 @@ void Heap::wrapper() {
 
 }
 
-int main() {
+// a heavy record: copying it copies its payload, moving it doesn't; copies are counted
+struct Job {
+	int priority;
+	long long id;
+	std::string name;
+	std::vector<double> payload;
+
+	static long long copies;
+
+	Job(int priority, long long id, size_t size)
+		: priority(priority), id(id), name("job " + std::to_string(id)), payload(size, 1.0) {}
+
+	Job(const Job &other) : priority(other.priority), id(other.id), name(other.name), payload(other.payload) { copies++; }
+	Job(Job &&) = default;
+
+	Job &operator=(const Job &other) {
+		priority = other.priority;
+		id = other.id;
+		name = other.name;
+		payload = other.payload;
+		copies++;
+		return *this;
+	}
+	Job &operator=(Job &&) = default;
+
+	bool operator<(const Job &other) const { return priority < other.priority; }
+};
+
+long long Job::copies = 0;
+
+// queue heavy jobs by priority and take them back in order, through PriorityQueue and through std::priority_queue
+int queueJobs(int count) {
+	static const size_t PAYLOAD = 64;
+	auto ordered = true;
+
+	auto run = [&](const char *name, auto &queue, auto take) {
+		std::mt19937 random(1);
+		Job::copies = 0;
+
+		auto start = std::chrono::steady_clock::now();
+		for (auto i = 0; i < count; i++)
+			queue.emplace(static_cast<int>(random() % 1000000), i, PAYLOAD);
+
+		auto last = 1000000;
+		while (!queue.empty()) {
+			auto job = take(queue);
+			ordered = ordered && job.priority <= last;
+			last = job.priority;
+		}
+		std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+
+		if (name)
+			std::cout << name << ": " << count << " jobs in " << time.count() << " ms, " << Job::copies << " copies" << std::endl;
+	};
+
+	// once unmeasured first, so that neither pays for the allocator's first pages
+	PriorityQueue<Job> queue;
+	run(nullptr, queue, [](PriorityQueue<Job> &queue) { return queue.take(); });
+	run("PriorityQueue", queue, [](PriorityQueue<Job> &queue) { return queue.take(); });
+
+	// its top() is const, so a job can only be copied out
+	std::priority_queue<Job> standard;
+	run("std::priority_queue", standard, [](std::priority_queue<Job> &queue) {
+		auto job = queue.top();
+		queue.pop();
+		return job;
+	});
+
+	if (!ordered)
+		std::cout << "JOBS CAME OUT OF ORDER" << std::endl;
+	return ordered ? 0 : 1;
+}
+
+// counts what it compares, for seeing what a heap's layout saves
+struct CountingLess {
+	long long *comparisons;
+
+	bool operator()(int first, int second) const {
+		(*comparisons)++;
+		return first < second;
+	}
+};
+
+// push random keys and pop them all, through heaps of each arity and through std::priority_queue; timed, then again counting comparisons
+int sortKeys(int count) {
+	if (count < 1)
+		return 1;
+
+	auto ordered = true;
+
+	std::vector<int> keys(count);
+	std::mt19937 random(1);
+	for (auto &key : keys)
+		key = static_cast<int>(random());
+
+	// the time to push them all, and to pop them all
+	auto sort = [&](auto &queue, double &pushing, double &popping) {
+		auto start = std::chrono::steady_clock::now();
+		for (auto key : keys)
+			queue.push(key);
+		auto pushed = std::chrono::steady_clock::now();
+
+		auto last = std::numeric_limits<int>::max();
+		while (!queue.empty()) {
+			ordered = ordered && queue.top() <= last;
+			last = queue.top();
+			queue.pop();
+		}
+		auto end = std::chrono::steady_clock::now();
+
+		pushing = std::chrono::duration<double, std::milli>(pushed - start).count();
+		popping = std::chrono::duration<double, std::milli>(end - pushed).count();
+	};
+
+	auto run = [&](const char *name, auto &&timed, auto &&counted, long long &comparisons) {
+		double pushing, popping;
+		sort(timed, pushing, popping);
+
+		comparisons = 0;
+		for (auto key : keys)
+			counted.push(key);
+		auto pushed = comparisons;
+		while (!counted.empty())
+			counted.pop();
+
+		std::cout << name << ": " << pushing << " ms to push, " << popping << " ms to pop, "
+			<< static_cast<double>(pushed) / count << " and " << static_cast<double>(comparisons - pushed) / count
+			<< " comparisons a key" << std::endl;
+	};
+
+	long long comparisons = 0;
+	CountingLess less = { &comparisons };
+	typedef std::vector<int, CacheAligned<int>> Keys;
+
+	run("std::priority_queue", std::priority_queue<int>(), std::priority_queue<int, std::vector<int>, CountingLess>(less), comparisons);
+	run("2-ary", PriorityQueue<int, std::less<int>, Keys, 2>(), PriorityQueue<int, CountingLess, Keys, 2>(less), comparisons);
+	run("4-ary", PriorityQueue<int, std::less<int>, Keys, 4>(), PriorityQueue<int, CountingLess, Keys, 4>(less), comparisons);
+	run("8-ary", PriorityQueue<int, std::less<int>, Keys, 8>(), PriorityQueue<int, CountingLess, Keys, 8>(less), comparisons);
+
+	if (!ordered)
+		std::cout << "KEYS CAME OUT OF ORDER" << std::endl;
+	return ordered ? 0 : 1;
+}
+
+// a directed graph in compressed rows: the edges of vertex v are first[v] to first[v + 1]
+struct Graph {
+	std::vector<int> first, targets;
+	std::vector<double> weights;
+};
+
+// a distance to a vertex, the shortest on top
+struct Reached {
+	double distance;
+	int vertex;
+
+	bool operator>(const Reached &other) const { return distance > other.distance; }
+};
+
+typedef std::greater<Reached> Shortest;
+
+// each vertex is queued once and its distance lowered in place
+std::vector<double> dijkstraIndexed(const Graph &graph, int source) {
+	auto vertexNumber = static_cast<int>(graph.first.size()) - 1;
+	std::vector<double> distances(vertexNumber, HUGE_VAL);
+	std::vector<IndexedHeap<Reached, Shortest>::Handle> handles(vertexNumber);
+	std::vector<bool> queued(vertexNumber, false);
+
+	IndexedHeap<Reached, Shortest> queue;
+	distances[source] = 0.0;
+	handles[source] = queue.push({ 0.0, source });
+	queued[source] = true;
+
+	while (!queue.empty()) {
+		auto reached = queue.take();
+		queued[reached.vertex] = false;
+
+		for (auto e = graph.first[reached.vertex]; e < graph.first[reached.vertex + 1]; e++) {
+			auto target = graph.targets[e];
+			auto distance = reached.distance + graph.weights[e];
+			if (distance >= distances[target])
+				continue;
+
+			distances[target] = distance;
+			if (queued[target]) {
+				queue.update(handles[target], { distance, target });
+			} else {
+				handles[target] = queue.push({ distance, target });
+				queued[target] = true;
+			}
+		}
+	}
+	return distances;
+}
+
+// without decrease-key: a shorter distance is queued again, and the stale ones are skipped when they come out
+std::vector<double> dijkstraLazy(const Graph &graph, int source, size_t &largest) {
+	auto vertexNumber = static_cast<int>(graph.first.size()) - 1;
+	std::vector<double> distances(vertexNumber, HUGE_VAL);
+
+	PriorityQueue<Reached, Shortest, std::vector<Reached, CacheAligned<Reached>>, 4> queue;
+	distances[source] = 0.0;
+	queue.push({ 0.0, source });
+	largest = 1;
+
+	while (!queue.empty()) {
+		auto reached = queue.take();
+		if (reached.distance > distances[reached.vertex])
+			continue;
+
+		for (auto e = graph.first[reached.vertex]; e < graph.first[reached.vertex + 1]; e++) {
+			auto target = graph.targets[e];
+			auto distance = reached.distance + graph.weights[e];
+			if (distance >= distances[target])
+				continue;
+
+			distances[target] = distance;
+			queue.push({ distance, target });
+		}
+		largest = std::max(largest, queue.size());
+	}
+	return distances;
+}
+
+// shortest paths over a random graph, with the indexed heap's decrease-key and with lazy reinsertion
+int shortestPaths(int vertexNumber, int degree) {
+	if (vertexNumber < 1 || degree < 0)
+		return 1;
+
+	// a path through every vertex, so all are reached, and degree random edges out of each
+	Graph graph;
+	std::mt19937 random(1);
+	std::uniform_real_distribution<double> weight(1.0, 100.0);
+	graph.first.reserve(vertexNumber + 1);
+	for (auto v = 0; v < vertexNumber; v++) {
+		graph.first.push_back(static_cast<int>(graph.targets.size()));
+		graph.targets.push_back((v + 1) % vertexNumber);
+		graph.weights.push_back(weight(random) * degree);
+		for (auto i = 0; i < degree; i++) {
+			graph.targets.push_back(static_cast<int>(random() % vertexNumber));
+			graph.weights.push_back(weight(random));
+		}
+	}
+	graph.first.push_back(static_cast<int>(graph.targets.size()));
+
+	auto start = std::chrono::steady_clock::now();
+	auto indexed = dijkstraIndexed(graph, 0);
+	std::chrono::duration<double, std::milli> indexedTime = std::chrono::steady_clock::now() - start;
+
+	size_t largest;
+	start = std::chrono::steady_clock::now();
+	auto lazy = dijkstraLazy(graph, 0, largest);
+	std::chrono::duration<double, std::milli> lazyTime = std::chrono::steady_clock::now() - start;
+
+	std::cout << vertexNumber << " vertices, " << graph.targets.size() << " edges" << std::endl;
+	std::cout << "IndexedHeap, decrease-key: " << indexedTime.count() << " ms" << std::endl;
+	std::cout << "PriorityQueue, queued again: " << lazyTime.count() << " ms, " << largest << " queued at most" << std::endl;
+
+	if (indexed != lazy) {
+		std::cout << "THE DISTANCES DIFFER" << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+// the baseline: one PriorityQueue behind one mutex
+class LockedQueue {
+	std::mutex lock;
+	PriorityQueue<int, std::less<int>, std::vector<int, CacheAligned<int>>, 4> queue;
+
+public:
+	void push(int key) {
+		std::lock_guard<std::mutex> guard(lock);
+		queue.push(key);
+	}
+
+	bool tryPop(int &key) {
+		std::lock_guard<std::mutex> guard(lock);
+		if (queue.empty())
+			return false;
+		key = queue.take();
+		return true;
+	}
+};
+
+// operations a second of threads pushing and popping by turns on a queue filled with prefill keys first
+template <typename Queue>
+double contend(Queue &queue, int threadNumber, int operations, int prefill) {
+	std::mt19937 random(1);
+	for (auto i = 0; i < prefill; i++)
+		queue.push(static_cast<int>(random() % 1000000000));
+
+	std::atomic<bool> go(false);
+	std::vector<std::thread> threads;
+	for (auto t = 0; t < threadNumber; t++)
+		threads.push_back(std::thread([&, t]() {
+			std::minstd_rand keys(t + 1);
+			auto share = operations / threadNumber;
+			while (!go)
+				std::this_thread::yield();
+
+			for (auto i = 0; i < share; i++) {
+				int key;
+				if (i % 2 == 0)
+					queue.push(static_cast<int>(keys() % 1000000000));
+				else
+					queue.tryPop(key);
+			}
+		}));
+
+	auto start = std::chrono::steady_clock::now();
+	go = true;
+	for (auto &thread : threads)
+		thread.join();
+	std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+
+	return operations / threadNumber * threadNumber / time.count();
+}
+
+/*
+how far from the top a MultiQueue's pops are: keys 0 to count - 1 pushed
+in random order and popped by one thread, each pop's rank the number of
+keys still queued that are greater than it, counted with a Fenwick tree
+*/
+double rankError(int count, size_t shards, size_t choices) {
+	std::vector<int> keys(count);
+	for (auto i = 0; i < count; i++)
+		keys[i] = i;
+	std::shuffle(keys.begin(), keys.end(), std::mt19937(1));
+
+	MultiQueue<int> queue(shards, choices);
+	for (auto key : keys)
+		queue.push(key);
+
+	// queued keys below i + 1, in tree[i + 1]
+	std::vector<int> tree(count + 1, 0);
+	auto add = [&](int key, int delta) {
+		for (auto i = key + 1; i <= count; i += i & -i)
+			tree[i] += delta;
+	};
+	auto below = [&](int key) {
+		auto sum = 0;
+		for (auto i = key; i > 0; i -= i & -i)
+			sum += tree[i];
+		return sum;
+	};
+	for (auto key : keys)
+		add(key, 1);
+
+	long long total = 0;
+	int key, left = count;
+	while (queue.tryPop(key)) {
+		total += left - below(key + 1);
+		add(key, -1);
+		left--;
+	}
+	return static_cast<double>(total) / count;
+}
+
+// MultiQueue against one locked heap from 1 thread up to maxThreads: lab5 concurrent [max threads] [operations]
+int contendQueues(int maxThreads, int operations) {
+	static const int PREFILL = 1000000;
+	static const size_t SHARDS_A_THREAD = 4;
+
+	std::cout << "threads   locked heap   MultiQueue (operations a second)" << std::endl;
+	for (auto threads = 1; threads <= maxThreads; threads *= 2) {
+		LockedQueue locked;
+		auto lockedRate = contend(locked, threads, operations, PREFILL);
+
+		MultiQueue<int> multi(SHARDS_A_THREAD * threads);
+		auto multiRate = contend(multi, threads, operations, PREFILL);
+
+		std::cout << std::setw(7) << threads << std::setw(14) << static_cast<long long>(lockedRate)
+			<< std::setw(13) << static_cast<long long>(multiRate) << std::endl;
+	}
+
+	std::cout << "Mean rank of a pop, 0 the top, over 1000000 keys:" << std::endl;
+	for (size_t shards : { 4, 16, 64, 256 })
+		std::cout << "  " << shards << " shards: " << rankError(1000000, shards, 2) << " with two choices, "
+			<< rankError(1000000, shards, 1) << " with one" << std::endl;
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	// queue heavy jobs by priority and take them back in order: lab5 jobs <count>
+	if (argc > 2 && std::string(argv[1]) == "jobs")
+		return queueJobs(atoi(argv[2]));
+
+	// heaps of 2, 4 and 8 children a node on that many random keys: lab5 heap <count>
+	if (argc > 2 && std::string(argv[1]) == "heap")
+		return sortKeys(atoi(argv[2]));
+
+	// Dijkstra on a random graph, with decrease-key and without: lab5 dijkstra <vertices> [edges a vertex]
+	if (argc > 2 && std::string(argv[1]) == "dijkstra")
+		return shortestPaths(atoi(argv[2]), argc > 3 ? atoi(argv[3]) : 4);
+
+	// throughput of a MultiQueue and of a locked heap from 1 thread to max threads: lab5 concurrent [max threads] [operations]
+	if (argc > 1 && std::string(argv[1]) == "concurrent")
+		return contendQueues(argc > 2 ? atoi(argv[2]) : 64, argc > 3 ? atoi(argv[3]) : 4000000);
+
 	Heap *heap = new Heap;
 	heap->wrapper();
 